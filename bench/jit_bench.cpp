@@ -0,0 +1,81 @@
+#include "../include/Expression.hpp"
+#include "../include/compiler.hpp"
+#include "../include/jit.hpp"
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using E = Expression<double>;
+
+namespace {
+
+// Выражения из tests/tests.cpp, увеличенные суммой сдвинутых копий:
+// сдвиг не даёт устранению общих подвыражений склеить слагаемые
+struct Case {
+    std::string name;
+    std::function<E(const E& x, const E& y)> term;
+};
+
+E scaled(const Case& c, int copies) {
+    E x("x"), y("y");
+    E sum = c.term(x, y);
+    for (int k = 1; k < copies; ++k) {
+        sum = sum + c.term(x + E(k * 1e-3), y - E(k * 1e-3));
+    }
+    return sum;
+}
+
+template<typename F>
+double nsPerEval(F&& f, const std::vector<double>& slots, size_t points) {
+    const size_t vars = 2;
+    volatile double sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < points; ++i) {
+        sink = sink + f(slots.data() + (i % 1024) * vars);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / points;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int copies = argc > 1 ? std::stoi(argv[1]) : 32;
+    const size_t points = argc > 2 ? std::stoul(argv[2]) : 200000;
+
+    std::vector<Case> cases = {
+        {"x + 2", [](const E& x, const E&) { return x + E(2.0); }},
+        {"x * x", [](const E& x, const E&) { return x * x; }},
+        {"x^3 * exp(-2x) / y", [](const E& x, const E& y) {
+             return (x ^ E(3.0)) * E::exp(E(-2.0) * x) / y; }},
+        {"sin(x) exp(y) + ln(x) cos(y)", [](const E& x, const E& y) {
+             return E::sin(x) * E::exp(y) + E::ln(x) * E::cos(y); }},
+    };
+
+    std::vector<double> slots;
+    for (int i = 0; i < 1024; ++i) {
+        slots.push_back(0.5 + i * 1e-3);
+        slots.push_back(1.0 + i * 2e-3);
+    }
+
+    std::cout << "copies: " << copies << ", points: " << points
+              << (JitFunction(compile(E(1.0))).native() ? "" : " (JIT disabled)") << "\n";
+    std::cout << std::left << std::setw(32) << "expression" << std::right
+              << std::setw(8) << "instrs" << std::setw(14) << "interp ns" << std::setw(12) << "jit ns"
+              << std::setw(10) << "speedup" << "\n";
+
+    for (const Case& c : cases) {
+        CompiledExpression<double> program = compile(scaled(c, copies), {"x", "y"});
+        JitFunction native(program);
+        double interp = nsPerEval([&](const double* s) { return program.eval(s); }, slots, points);
+        double jit = nsPerEval([&](const double* s) { return native(s); }, slots, points);
+        std::cout << std::left << std::setw(32) << c.name << std::right
+                  << std::setw(8) << program.code().size()
+                  << std::setw(14) << std::fixed << std::setprecision(1) << interp
+                  << std::setw(12) << jit
+                  << std::setw(9) << std::setprecision(2) << interp / jit << "x\n";
+    }
+    return 0;
+}
@@ -0,0 +1,188 @@
+// Нагрузочный клиент для differentiator --serve: несколько соединений,
+// в каждом выражение разбирается один раз, затем по дескриптору идут
+// запросы eval/gradient. Печатает пропускную способность и задержки.
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string path;
+    std::string expression = "x^3 * sin(y) + ln(x + y) / exp(y)";
+    std::string op = "eval";
+    size_t connections = 4;
+    size_t requests = 10000;
+    size_t pipeline = 1;  // запросов в полёте на соединение
+};
+
+class Connection {
+public:
+    explicit Connection(const std::string& path) {
+        fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        if (fd_ < 0 || connect(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+            throw std::runtime_error("Cannot connect to " + path + ": " + std::strerror(errno));
+        }
+    }
+    ~Connection() { close(fd_); }
+
+    void send(const std::string& data) {
+        for (size_t sent = 0; sent < data.size();) {
+            ssize_t n = ::send(fd_, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) throw std::runtime_error("send failed");
+            sent += static_cast<size_t>(n);
+        }
+    }
+
+    std::string readLine() {
+        while (true) {
+            size_t eol = buffer_.find('\n');
+            if (eol != std::string::npos) {
+                std::string line = buffer_.substr(0, eol);
+                buffer_.erase(0, eol + 1);
+                return line;
+            }
+            char chunk[4096];
+            ssize_t n = recv(fd_, chunk, sizeof(chunk), 0);
+            if (n <= 0) throw std::runtime_error("connection closed");
+            buffer_.append(chunk, static_cast<size_t>(n));
+        }
+    }
+
+private:
+    int fd_ = -1;
+    std::string buffer_;
+};
+
+std::string escape(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+// Дескриптор из ответа {"handle":N,...}
+std::string handleOf(const std::string& reply) {
+    size_t pos = reply.find("\"handle\":");
+    if (pos == std::string::npos) throw std::runtime_error("Server error: " + reply);
+    pos += 9;
+    return reply.substr(pos, reply.find_first_of(",}", pos) - pos);
+}
+
+// Переменные из ответа parse: "variables":["x","y"]
+std::vector<std::string> variablesOf(const std::string& reply) {
+    std::vector<std::string> names;
+    size_t pos = reply.find("\"variables\":[");
+    size_t end = reply.find(']', pos);
+    for (size_t q = reply.find('"', pos + 13); q < end; q = reply.find('"', q + 1)) {
+        size_t close = reply.find('"', q + 1);
+        names.push_back(reply.substr(q + 1, close - q - 1));
+        q = close;
+    }
+    return names;
+}
+
+void worker(const Options& options, size_t index, std::vector<double>& latencies) {
+    Connection connection(options.path);
+    connection.send("{\"op\":\"parse\",\"expression\":\"" + escape(options.expression) + "\"}\n");
+    std::string parsed = connection.readLine();
+    std::string handle = handleOf(parsed);
+    std::vector<std::string> names = variablesOf(parsed);
+
+    auto request = [&](size_t i) {
+        std::string out = "{\"op\":\"" + options.op + "\",\"handle\":" + handle + ",\"bindings\":{";
+        for (size_t k = 0; k < names.size(); ++k) {
+            if (k > 0) out += ',';
+            out += "\"" + names[k] + "\":" + std::to_string(0.5 + 1e-4 * ((i * 31 + index + k) % 10000));
+        }
+        return out + "}}\n";
+    };
+
+    // Окно из pipeline запросов: задержка — от отправки до получения ответа
+    std::vector<Clock::time_point> sentAt(options.requests);
+    size_t sent = 0;
+    for (size_t received = 0; received < options.requests; ++received) {
+        while (sent < options.requests && sent < received + options.pipeline) {
+            sentAt[sent] = Clock::now();
+            connection.send(request(sent++));
+        }
+        std::string reply = connection.readLine();
+        if (reply.find("\"error\"") != std::string::npos) {
+            throw std::runtime_error("Server error: " + reply);
+        }
+        latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - sentAt[received]).count());
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) throw std::runtime_error("Missing value for " + arg);
+            return argv[++i];
+        };
+        if (arg == "--connections") options.connections = std::stoul(value());
+        else if (arg == "--requests") options.requests = std::stoul(value());
+        else if (arg == "--pipeline") options.pipeline = std::max<size_t>(1, std::stoul(value()));
+        else if (arg == "--expression") options.expression = value();
+        else if (arg == "--op") options.op = value();
+        else options.path = arg;
+    }
+    if (options.path.empty()) {
+        std::cerr << "Usage: load_client socket_path [--connections N] [--requests N] [--pipeline N]"
+                     " [--op eval|gradient] [--expression \"expr\"]\n";
+        return 1;
+    }
+
+    std::vector<std::vector<double>> latencies(options.connections);
+    std::vector<std::thread> threads;
+    std::vector<std::string> errors(options.connections);
+    auto start = Clock::now();
+    for (size_t c = 0; c < options.connections; ++c) {
+        threads.emplace_back([&, c] {
+            try {
+                worker(options, c, latencies[c]);
+            } catch (const std::exception& ex) {
+                errors[c] = ex.what();
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (const std::string& error : errors) {
+        if (!error.empty()) {
+            std::cerr << "Error: " << error << "\n";
+            return 1;
+        }
+    }
+
+    std::vector<double> all;
+    for (const auto& list : latencies) all.insert(all.end(), list.begin(), list.end());
+    std::sort(all.begin(), all.end());
+    auto percentile = [&](double p) { return all[std::min(all.size() - 1, static_cast<size_t>(p * all.size()))]; };
+
+    std::cout << "requests: " << all.size() << " over " << options.connections << " connections, "
+              << "pipeline " << options.pipeline << "\n";
+    std::cout << "throughput: " << static_cast<size_t>(all.size() / seconds) << " req/s\n";
+    std::cout << "latency us: p50 " << percentile(0.50) << ", p90 " << percentile(0.90)
+              << ", p99 " << percentile(0.99) << ", max " << all.back() << "\n";
+    return 0;
+}
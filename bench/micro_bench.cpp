@@ -0,0 +1,335 @@
+// Набор микробенчмарков публичных операций Expression<double> и parseExpression.
+// Для каждой операции и каждого генератора выражений печатает ns/op,
+// выделений памяти на операцию и пиковый RSS; с --json — то же в JSON.
+// Исходное выражение живёт всё время замера, поэтому узлы, структурно равные
+// его узлам, не создаются заново (например, parse не выделяет памяти).
+#include "../include/Expression.hpp"
+#include "../include/compiler.hpp"
+#include "../include/json.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+// ===== Подсчёт выделений: замена глобального operator new =====
+
+// GCC не видит, что operator new ниже выделяет через malloc
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+namespace {
+std::atomic<size_t> allocations{0};
+}
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+// Выровненные версии: BlockPool берёт слэбы узлов через
+// operator new(size, align_val_t), их тоже нужно считать
+void* operator new(size_t size, std::align_val_t align) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    const size_t alignment = static_cast<size_t>(align);
+    // aligned_alloc требует размер, кратный выравниванию
+    const size_t rounded = (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment;
+    if (void* p = std::aligned_alloc(alignment, rounded)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size, std::align_val_t align) { return operator new(size, align); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+namespace {
+
+using E = Expression<double>;
+using Clock = std::chrono::steady_clock;
+
+// ===== Пиковый RSS =====
+
+// На Linux пик сбрасывается перед каждым замером (clear_refs 5), поэтому
+// значение относится к одному бенчмарку; иначе это пик процесса с начала работы
+void resetPeakRss() {
+#ifdef __linux__
+    std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+size_t peakRssKb() {
+#ifdef __linux__
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) return std::stoul(line.substr(6));
+    }
+#endif
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss) / 1024;
+#else
+    return static_cast<size_t>(usage.ru_maxrss);
+#endif
+}
+
+// ===== Генераторы выражений =====
+
+struct Config {
+    int depth = 8;        // глубина случайного дерева
+    int width = 64;       // слагаемых в широкой сумме
+    int variables = 3;
+    int chain = 64;       // длина цепочки тригонометрии
+    int degree = 200;     // степень полинома
+    unsigned seed = 42;
+    double minTimeMs = 200;
+    std::string filter;
+    bool json = false;
+};
+
+// Собственное равномерное распределение: стандартные распределения дают разные
+// последовательности в разных библиотеках, а набор должен быть воспроизводимым
+class Random {
+public:
+    explicit Random(unsigned seed) : engine_(seed) {}
+    unsigned below(unsigned n) { return static_cast<unsigned>(engine_() % n); }
+    double constant() { return 0.5 + below(1000) / 100.0; }
+private:
+    std::mt19937 engine_;
+};
+
+std::vector<E> variablesOf(int count) {
+    std::vector<E> vars;
+    for (int i = 0; i < count; ++i) vars.emplace_back("x" + std::to_string(i));
+    return vars;
+}
+
+// Случайное дерево заданной глубины без унарного минуса: текстовая форма
+// должна разбираться обратно
+E randomTree(Random& rnd, const std::vector<E>& vars, int depth) {
+    if (depth == 0) {
+        return rnd.below(3) == 0 ? E(rnd.constant()) : vars[rnd.below(static_cast<unsigned>(vars.size()))];
+    }
+    // Операнды строятся по порядку: порядок вычисления аргументов оператора
+    // не задан стандартом, а дерево должно совпадать у разных компиляторов
+    unsigned op = rnd.below(9);
+    E a = randomTree(rnd, vars, depth - 1);
+    if (op <= 2) {
+        if (op == 0) return E::sin(a);
+        if (op == 1) return E::exp(a / E(10.0));
+        return a ^ E(2.0);
+    }
+    E b = randomTree(rnd, vars, depth - 1);
+    switch (op) {
+        case 3: case 4: return a + b;
+        case 5: return a - b;
+        case 6: case 7: return a * b;
+        default: return a / (b + E(1.0));
+    }
+}
+
+// Сумма width произведений пар переменных с коэффициентами
+E wideSum(Random& rnd, const std::vector<E>& vars, int width) {
+    E sum(rnd.constant());
+    for (int i = 0; i < width; ++i) {
+        unsigned a = rnd.below(static_cast<unsigned>(vars.size()));
+        unsigned b = rnd.below(static_cast<unsigned>(vars.size()));
+        E coefficient(rnd.constant());
+        sum = sum + coefficient * vars[a] * vars[b];
+    }
+    return sum;
+}
+
+// sin(cos(sin(... x0 ...)))
+E trigChain(const std::vector<E>& vars, int length) {
+    E expr = vars[0];
+    for (int i = 0; i < length; ++i) {
+        expr = i % 2 == 0 ? E::sin(expr) : E::cos(expr);
+    }
+    return expr;
+}
+
+// Σ c_k x0^k
+E polynomial(Random& rnd, const std::vector<E>& vars, int degree) {
+    E sum(rnd.constant());
+    for (int k = 1; k <= degree; ++k) {
+        E coefficient(rnd.constant());
+        sum = sum + coefficient * (vars[0] ^ E(static_cast<double>(k)));
+    }
+    return sum;
+}
+
+struct Case {
+    std::string name;
+    E expr;
+};
+
+std::vector<Case> makeCases(const Config& config) {
+    Random rnd(config.seed);
+    std::vector<E> vars = variablesOf(config.variables);
+    return {
+        {"random_tree", randomTree(rnd, vars, config.depth)},
+        {"wide_sum", wideSum(rnd, vars, config.width)},
+        {"trig_chain", trigChain(vars, config.chain)},
+        {"polynomial", polynomial(rnd, vars, config.degree)},
+    };
+}
+
+// ===== Замер =====
+
+struct Result {
+    std::string operation;
+    std::string caseName;
+    size_t iterations;
+    double nsPerOp;
+    double allocationsPerOp;
+    size_t peakRssKb;
+};
+
+// Повторение op до minTimeMs (не меньше трёх раз) после одного прогревочного вызова
+Result measure(const std::string& operation, const std::string& caseName, const Config& config,
+               const std::function<void()>& op) {
+    op();
+    resetPeakRss();
+    size_t allocationsBefore = allocations.load(std::memory_order_relaxed);
+    size_t iterations = 0;
+    auto start = Clock::now();
+    double elapsedMs = 0;
+    do {
+        op();
+        ++iterations;
+        elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    } while (elapsedMs < config.minTimeMs || iterations < 3);
+    size_t allocated = allocations.load(std::memory_order_relaxed) - allocationsBefore;
+    return {operation, caseName, iterations, elapsedMs * 1e6 / iterations,
+            static_cast<double>(allocated) / iterations, peakRssKb()};
+}
+
+// Результат операции уходит сюда, чтобы компилятор не выбросил вычисление
+volatile double sink;
+
+std::vector<Result> runSuite(const Config& config) {
+    std::vector<Result> results;
+    std::vector<std::string> names;
+    std::map<std::string, double> values;
+    std::map<std::string, E> swaps;
+    Bindings<double> bindings;
+    for (int i = 0; i < config.variables; ++i) {
+        std::string name = "x" + std::to_string(i);
+        names.push_back(name);
+        values[name] = 0.25 + 0.1 * i;
+        bindings.set(Symbol(name), values[name]);
+        swaps.emplace(name, E("x" + std::to_string((i + 1) % config.variables)));
+    }
+
+    for (const Case& c : makeCases(config)) {
+        const E& expr = c.expr;
+        std::string text = expr.toString();
+        CompiledExpression<double> program = compile(expr, names);
+        std::vector<double> slots;
+        for (const std::string& name : names) slots.push_back(values[name]);
+
+        std::vector<std::pair<std::string, std::function<void()>>> operations = {
+            {"parse", [&] { sink = static_cast<double>(parseExpression<double>(text).arity()); }},
+            {"to_string", [&] { sink = static_cast<double>(expr.toString().size()); }},
+            {"differentiate", [&] { sink = static_cast<double>(expr.differentiate(names[0]).arity()); }},
+            {"differentiate_raw", [&] { sink = static_cast<double>(expr.differentiate(names[0], false).arity()); }},
+            {"simplify", [&] { sink = static_cast<double>(expr.simplify().arity()); }},
+            {"substitute_values", [&] { sink = static_cast<double>(expr.substitute_all(values).arity()); }},
+            {"substitute_expressions", [&] { sink = static_cast<double>(expr.substitute(swaps).arity()); }},
+            {"evaluate_map", [&] { sink = expr.evaluate(values); }},
+            {"evaluate_bindings", [&] { sink = expr.evaluate(bindings); }},
+            {"gradient", [&] { sink = expr.gradient(values).begin()->second; }},
+            {"compile", [&] { sink = static_cast<double>(compile(expr, names).code().size()); }},
+            {"compiled_eval", [&] { sink = program.eval(slots.data()); }},
+        };
+        for (const auto& [operation, op] : operations) {
+            std::string label = operation + "/" + c.name;
+            if (!config.filter.empty() && label.find(config.filter) == std::string::npos) continue;
+            results.push_back(measure(operation, c.name, config, op));
+            if (!config.json) {
+                const Result& r = results.back();
+                std::cout << std::left << std::setw(40) << label << std::right << std::fixed
+                          << std::setw(14) << std::setprecision(1) << r.nsPerOp
+                          << std::setw(12) << std::setprecision(2) << r.allocationsPerOp
+                          << std::setw(12) << r.peakRssKb << std::endl;
+            }
+        }
+    }
+    return results;
+}
+
+void printJson(const Config& config, const std::vector<Result>& results) {
+    std::cout << "{\"suite\":\"micro_bench\",\"config\":{"
+              << "\"depth\":" << config.depth << ",\"width\":" << config.width
+              << ",\"variables\":" << config.variables << ",\"chain\":" << config.chain
+              << ",\"degree\":" << config.degree << ",\"seed\":" << config.seed
+              << ",\"min_time_ms\":" << jsonNumber(config.minTimeMs) << "},\"results\":[";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        std::cout << (i > 0 ? "," : "") << "\n  {\"operation\":" << jsonQuote(r.operation)
+                  << ",\"case\":" << jsonQuote(r.caseName)
+                  << ",\"iterations\":" << r.iterations
+                  << ",\"ns_per_op\":" << jsonNumber(r.nsPerOp)
+                  << ",\"allocations_per_op\":" << jsonNumber(r.allocationsPerOp)
+                  << ",\"peak_rss_kb\":" << r.peakRssKb << "}";
+    }
+    std::cout << "\n]}\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Config config;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << "\n";
+                std::exit(1);
+            }
+            return argv[++i];
+        };
+        if (arg == "--json") config.json = true;
+        else if (arg == "--filter") config.filter = value();
+        else if (arg == "--depth") config.depth = std::stoi(value());
+        else if (arg == "--width") config.width = std::stoi(value());
+        else if (arg == "--vars") config.variables = std::max(1, std::stoi(value()));
+        else if (arg == "--chain") config.chain = std::stoi(value());
+        else if (arg == "--degree") config.degree = std::stoi(value());
+        else if (arg == "--seed") config.seed = static_cast<unsigned>(std::stoul(value()));
+        else if (arg == "--min-time") config.minTimeMs = std::stod(value());
+        else {
+            std::cerr << "Usage: micro_bench [--json] [--filter substr] [--depth N] [--width N] [--vars N]\n"
+                         "                   [--chain N] [--degree N] [--seed N] [--min-time ms]\n";
+            return 1;
+        }
+    }
+
+    if (!config.json) {
+        std::cout << std::left << std::setw(40) << "operation/case" << std::right << std::setw(14) << "ns/op"
+                  << std::setw(12) << "allocs/op" << std::setw(12) << "peak KB" << "\n";
+    }
+    std::vector<Result> results = runSuite(config);
+    if (config.json) printJson(config, results);
+    return 0;
+}
@@ -0,0 +1,199 @@
+// Пропускная способность разбора файла с одним выражением на строку, МБ/с:
+// последовательный parseExpression по строкам против parseLines на пулах
+// разного размера. Вход — сгенерированный каталог или файл (--input).
+// Результаты каждого прогона освобождаются вне замера, поэтому каждый
+// прогон строит узлы заново.
+#include "../include/bulk_parser.hpp"
+#include "../include/json.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using E = Expression<double>;
+using Clock = std::chrono::steady_clock;
+
+struct Config {
+    size_t lines = 200000;
+    int depth = 6;
+    unsigned seed = 42;
+    int repeat = 3;
+    std::vector<size_t> threads;
+    std::string input;
+    bool json = false;
+};
+
+// Собственное равномерное распределение: набор должен быть воспроизводимым
+class Random {
+public:
+    explicit Random(unsigned seed) : engine_(seed) {}
+    unsigned below(unsigned n) { return static_cast<unsigned>(engine_() % n); }
+private:
+    std::mt19937 engine_;
+};
+
+// Случайная формула как текст: переменные x0..x9, константы, функции,
+// бинарные операции и унарный минус
+void randomFormula(Random& rnd, int depth, std::string& out) {
+    if (depth == 0 || rnd.below(4) == 0) {
+        if (rnd.below(3) == 0) {
+            out += std::to_string(rnd.below(1000) / 100.0).substr(0, 4);
+        } else {
+            out += 'x';
+            out += static_cast<char>('0' + rnd.below(10));
+        }
+        return;
+    }
+    static const char* const functions[] = {"sin(", "cos(", "exp(", "ln("};
+    static const char* const operators[] = {" + ", " - ", " * ", " / ", " ^ "};
+    unsigned kind = rnd.below(10);
+    if (kind < 2) {
+        out += functions[rnd.below(4)];
+        randomFormula(rnd, depth - 1, out);
+        out += ')';
+    } else if (kind == 2) {
+        out += "-(";
+        randomFormula(rnd, depth - 1, out);
+        out += ')';
+    } else {
+        out += '(';
+        randomFormula(rnd, depth - 1, out);
+        out += operators[rnd.below(5)];
+        randomFormula(rnd, depth - 1, out);
+        out += ')';
+    }
+}
+
+std::string makeCatalog(const Config& config) {
+    Random rnd(config.seed);
+    std::string text;
+    for (size_t i = 0; i < config.lines; ++i) {
+        randomFormula(rnd, config.depth, text);
+        text += '\n';
+    }
+    return text;
+}
+
+struct Result {
+    std::string mode;
+    size_t threads;
+    double seconds;
+    size_t expressions;
+};
+
+// Лучшее время из config.repeat прогонов
+template<typename Parse>
+Result measure(const std::string& mode, size_t threads, const Config& config, Parse parse) {
+    Result result{mode, threads, 1e300, 0};
+    for (int r = 0; r < config.repeat; ++r) {
+        auto start = Clock::now();
+        std::vector<E> parsed = parse();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        result.seconds = std::min(result.seconds, seconds);
+        result.expressions = parsed.size();
+    }
+    return result;
+}
+
+std::vector<E> parseSequential(const std::string& text) {
+    std::vector<E> result;
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        result.push_back(parseExpression<double>(line));
+    }
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Config config;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << "\n";
+                std::exit(1);
+            }
+            return argv[++i];
+        };
+        if (arg == "--json") config.json = true;
+        else if (arg == "--lines") config.lines = std::stoul(value());
+        else if (arg == "--depth") config.depth = std::stoi(value());
+        else if (arg == "--seed") config.seed = static_cast<unsigned>(std::stoul(value()));
+        else if (arg == "--repeat") config.repeat = std::max(1, std::stoi(value()));
+        else if (arg == "--input") config.input = value();
+        else if (arg == "--threads") {
+            std::istringstream list(value());
+            std::string item;
+            while (std::getline(list, item, ',')) config.threads.push_back(std::stoul(item));
+        } else {
+            std::cerr << "Usage: parse_bench [--json] [--input file] [--lines N] [--depth N] [--seed N]\n"
+                         "                   [--repeat N] [--threads N,N,...]\n";
+            return 1;
+        }
+    }
+    if (config.threads.empty()) {
+        size_t cores = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t n = 1; n < cores; n *= 2) config.threads.push_back(n);
+        config.threads.push_back(cores);
+    }
+
+    std::string text;
+    if (config.input.empty()) {
+        text = makeCatalog(config);
+    } else {
+        std::ifstream file(config.input, std::ios::binary);
+        if (!file) {
+            std::cerr << "Cannot open " << config.input << "\n";
+            return 1;
+        }
+        std::ostringstream buffer;
+        buffer << file.rdbuf();
+        text = buffer.str();
+    }
+
+    std::vector<Result> results;
+    results.push_back(measure("sequential", 1, config, [&] { return parseSequential(text); }));
+    for (size_t threads : config.threads) {
+        ThreadPool pool(threads);
+        results.push_back(measure("parse_lines", pool.size(), config, [&] { return parseLines<double>(text, pool); }));
+    }
+
+    const double megabytes = text.size() / 1e6;
+    const double baseline = results.front().seconds;
+    if (config.json) {
+        std::cout << "{\"suite\":\"parse_bench\",\"bytes\":" << text.size() << ",\"results\":[";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result& r = results[i];
+            std::cout << (i > 0 ? "," : "") << "\n  {\"mode\":" << jsonQuote(r.mode) << ",\"threads\":" << r.threads
+                      << ",\"expressions\":" << r.expressions << ",\"seconds\":" << jsonNumber(r.seconds)
+                      << ",\"mb_per_s\":" << jsonNumber(megabytes / r.seconds) << "}";
+        }
+        std::cout << "\n]}\n";
+        return 0;
+    }
+
+    std::cout << std::fixed << std::setprecision(2) << megabytes << " MB, " << results.front().expressions
+              << " expressions\n";
+    std::cout << std::left << std::setw(14) << "mode" << std::right << std::setw(8) << "threads" << std::setw(12)
+              << "MB/s" << std::setw(14) << "lines/s" << std::setw(10) << "speedup" << "\n";
+    for (const Result& r : results) {
+        std::cout << std::left << std::setw(14) << r.mode << std::right << std::setw(8) << r.threads
+                  << std::setw(12) << std::setprecision(1) << megabytes / r.seconds
+                  << std::setw(14) << std::setprecision(0) << r.expressions / r.seconds
+                  << std::setw(10) << std::setprecision(2) << baseline / r.seconds << "\n";
+    }
+    return 0;
+}
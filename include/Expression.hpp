@@ -1,9 +1,35 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <memory>
 #include <map>
 #include <complex>
+#include <unordered_map>
+#include <vector>
+#include "pool_allocator.hpp"
+#include "symbol.hpp"
+
+// Тип узла дерева выражения
+enum class NodeKind {
+    Constant,
+    Variable,
+    // Унарные функции
+    Neg,
+    Sin,
+    Cos,
+    Ln,
+    Exp,
+    // Бинарные операции
+    Add,
+    Sub,
+    Mul,
+    Div,
+    Pow
+};
+
+template<typename T>
+class DerivativeCache;
 
 template<typename T>
 class Expression {
@@ -11,6 +37,7 @@ public:
     // Конструкторы
     Expression(T value);
     Expression(const std::string& variable);
+    explicit Expression(Symbol variable);
     Expression(const Expression& other);
     Expression& operator=(const Expression& other);
     Expression(Expression&& other) noexcept = default;
@@ -23,6 +50,12 @@ public:
     Expression operator*(const Expression& rhs) const;
     Expression operator/(const Expression& rhs) const;
     Expression operator^(const Expression& rhs) const;
+    Expression operator-() const;
+
+    // Структурное равенство: узлы хранятся в единственном экземпляре,
+    // поэтому достаточно сравнить указатели
+    bool operator==(const Expression& rhs) const { return pImpl == rhs.pImpl; }
+    bool operator!=(const Expression& rhs) const { return pImpl != rhs.pImpl; }
 
     // Математические функции
     static Expression sin(const Expression& expr);
@@ -36,17 +69,128 @@ public:
     // Подстановка переменной, вычисление, дифференцирование
     Expression<T> substitute_all(const std::map<std::string, T>& vars) const;
     Expression substitute(const std::string& var, const T& value) const;
+    // Одновременная подстановка выражений вместо переменных за один обход:
+    // {x: y, y: x} меняет переменные местами, нетронутые поддеревья общие с исходным
+    Expression substitute(const std::map<std::string, Expression>& replacements) const;
     T evaluate(const std::map<std::string, T>& vars) const;
-    Expression differentiate(const std::string& variable) const;
+    // Переменные ищутся по номеру символа, без сравнения строк
+    T evaluate(const Bindings<T>& vars) const;
+    // По умолчанию результат сразу упрощается через simplify()
+    Expression differentiate(const std::string& variable, bool simplifyResult = true) const;
+    Expression differentiate(Symbol variable, bool simplifyResult = true) const;
+    // То же с общим кэшем: повторные производные подвыражений берутся из него
+    Expression differentiate(const std::string& variable, DerivativeCache<T>& cache,
+                             bool simplifyResult = true) const;
+    Expression differentiate(Symbol variable, DerivativeCache<T>& cache, bool simplifyResult = true) const;
+
+    // Все частные производные в точке за один прямой и один обратный проход.
+    // Ключи результата — переменные из vars
+    std::map<std::string, T> gradient(const std::map<std::string, T>& vars) const;
+
+    // Алгебраическое упрощение: свёртка констант, устранение 0 и 1,
+    // приведение подобных слагаемых, слияние степеней, каноничный порядок.
+    // Тождества применяются как для конечных значений: x - x и 0 * x дают 0,
+    // x / x и x^0 — 1, даже если в точке вычисления x бесконечен или NaN,
+    // поэтому в полюсах упрощённое выражение может быть конечным там, где
+    // исходное давало inf или NaN
+    Expression simplify() const;
+
+    // Структура дерева: тип узла, значение константы, имя переменной, операнды
+    NodeKind kind() const;
+    const T& value() const;
+    const std::string& name() const;
+    Symbol symbol() const;
+    size_t arity() const;
+    Expression operand(size_t index) const;
+    // Идентификатор узла: равен у структурно равных выражений
+    const void* id() const { return pImpl.get(); }
 
 private:
-    struct Impl {
-        std::string expr;
-        Impl(const std::string& s) : expr(s) {}
+    // Узел дерева: константа, переменная, унарная функция или бинарная операция.
+    // Узлы неизменяемы и создаются только через makeNode, которая возвращает
+    // уже существующий структурно равный узел, если он есть (hash-consing).
+    struct Impl : std::enable_shared_from_this<Impl> {
+        NodeKind kind;
+        T value;
+        Symbol symbol;
+        std::shared_ptr<const Impl> lhs;
+        std::shared_ptr<const Impl> rhs;
+        size_t hash;
+        mutable const Impl* chain = nullptr;  // следующий узел в корзине таблицы узлов
+
+        Impl(NodeKind kind, const T& value, Symbol symbol,
+             std::shared_ptr<const Impl> lhs, std::shared_ptr<const Impl> rhs, size_t hash);
+        ~Impl();
     };
-    std::unique_ptr<Impl> pImpl;
+    std::shared_ptr<const Impl> pImpl;
+
+    explicit Expression(std::shared_ptr<const Impl> node);
+    static std::shared_ptr<const Impl> makeNode(NodeKind kind, const T& value, Symbol symbol,
+                                                std::shared_ptr<const Impl> lhs,
+                                                std::shared_ptr<const Impl> rhs);
+    static Expression unary(NodeKind kind, const Expression& arg);
+    static Expression binary(NodeKind kind, const Expression& lhs, const Expression& rhs);
+
+    Expression derivative(Symbol var, DerivativeCache<T>& cache) const;
+    // Зависит ли узел от переменной: общий для одного вызова derivative
+    using DependencyMemo = std::unordered_map<const void*, bool>;
+    // Правило для узла; du и dv — производные операндов (dv == nullptr, если не нужна)
+    Expression derivativeRule(Symbol var, const Expression& du, const Expression* dv,
+                              DependencyMemo& depends) const;
+
+    static void print(const Impl* node, std::string& out);
+    static T evaluate(const Impl* node, const Bindings<T>& vars);
+    using Replacements = SymbolMap<std::shared_ptr<const Impl>>;
+    using SubstituteMemo = std::unordered_map<const Impl*, std::shared_ptr<const Impl>>;
+    static std::shared_ptr<const Impl> substitute(const std::shared_ptr<const Impl>& node,
+                                                  const Replacements& replacements, SubstituteMemo& memo);
 };
 
-// Парсер выражений из строки
+// Кэш производных на время сессии (например, при вычислении гессиана или
+// производных высоких порядков). Ключ — узел подвыражения и переменная;
+// хранятся неупрощённые производные. Не потокобезопасен.
+template<typename T>
+class DerivativeCache {
+public:
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+    size_t size() const { return entries_.size(); }
+    void clear() {
+        entries_.clear();
+        hits_ = 0;
+        misses_ = 0;
+    }
+
+private:
+    friend class Expression<T>;
+
+    struct Key {
+        const void* node;
+        uint32_t variable;
+        bool operator==(const Key& other) const { return node == other.node && variable == other.variable; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return std::hash<const void*>()(key.node) * 31 + key.variable;
+        }
+    };
+
+    // Исходное подвыражение хранится рядом с производной, чтобы узел-ключ жил
+    using Entry = std::pair<Expression<T>, Expression<T>>;
+    std::unordered_map<Key, Entry, KeyHash, std::equal_to<Key>, PoolAllocator<std::pair<const Key, Entry>>> entries_;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+};
+
+// Ограничения разбора для недоверенного входа; 0 — без ограничения
+struct ParseLimits {
+    size_t maxDepth = 0;   // вложенность скобок, вызовов функций и префиксных операций
+    size_t maxNodes = 0;   // число операндов и операций во входе
+};
+
+// Парсер выражений из строки со стандартной таблицей операций (parser.hpp).
+// Ошибки — ParseError с позицией
+template<typename T>
+Expression<T> parseExpression(std::string_view input);
 template<typename T>
-Expression<T> parseExpression(const std::string& input);
+Expression<T> parseExpression(std::string_view input, const ParseLimits& limits);
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include "compiler.hpp"
+#include "thread_pool.hpp"
+
+// Число значений, обрабатываемых одной векторной инструкцией пакетного режима
+constexpr size_t BatchLanes = 8;
+
+// Пакетное вычисление по столбцам (structure-of-arrays):
+// columns[i] указывает на count значений переменной program.variables()[i],
+// out получает count результатов. Программа исполняется блоками по BatchLanes
+// значений, функции sin/cos/exp/ln вычисляются векторными ядрами.
+void evaluateBatch(const CompiledExpression<double>& program,
+                   const double* const* columns, double* out, size_t count);
+
+// То же, но диапазон точек делится между потоками пула. Каждый результат
+// пишется в свою позицию out, поэтому порядок не зависит от числа потоков.
+void evaluateBatch(const CompiledExpression<double>& program,
+                   const double* const* columns, double* out, size_t count, ThreadPool& pool);
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include "Expression.hpp"
+#include "parser.hpp"
+#include "thread_pool.hpp"
+
+// Разбор буфера с одним выражением на строку на всех потоках пула.
+// Буфер режется на участки по границам строк, участков в несколько раз больше,
+// чем потоков, и пул раздаёт их с перехватом работы. Каждый участок собирает
+// свои выражения отдельно; узлы сразу попадают в общую таблицу узлов, так что
+// одинаковые подвыражения разных строк — один узел. Результат склеивается
+// в порядке строк. Пустые строки (из пробелов) пропускаются.
+// Ошибка — ParseError с позицией в буфере; из нескольких ошибок — первая по порядку строк.
+template<typename T>
+std::vector<Expression<T>> parseLines(std::string_view text, ThreadPool& pool,
+                                      const OperatorTable<T>& operators = OperatorTable<T>::standard(),
+                                      const ParseLimits& limits = ParseLimits());
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Expression.hpp"
+
+struct CodegenOptions {
+    std::string name = "evaluate";     // имя генерируемой функции
+    std::vector<std::string> labels;   // подписи выходов для комментариев
+    bool kernel = false;               // добавить цикл по столбцам name_kernel
+};
+
+// Исходный код на C++ без зависимостей от библиотеки:
+//   inline void name(double _v0, double _v1, double* out)
+// вычисляет все выходы за один проход, общие подвыражения считаются один раз.
+// Параметры переменных пронумерованы, исходные имена — в комментариях.
+// С options.kernel добавляется цикл по массивам
+//   inline void name_kernel(const double* _v0, const double* _v1, double* out0, ..., std::size_t n),
+// который компилятор может векторизовать. Пустой outputs — std::invalid_argument.
+std::string generateCpp(const std::vector<Expression<double>>& outputs,
+                        const std::vector<std::string>& variables = {},
+                        const CodegenOptions& options = {});
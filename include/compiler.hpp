@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "Expression.hpp"
+
+// Код операции виртуальной машины
+enum class OpCode : uint8_t {
+    Neg,
+    Sin,
+    Cos,
+    Ln,
+    Exp,
+    Add,
+    Sub,
+    Mul,
+    Div,
+    Pow
+};
+
+// Инструкция регистровой машины: dst = op(a, b)
+struct Instruction {
+    OpCode op;
+    uint32_t dst;
+    uint32_t a;
+    uint32_t b;
+};
+
+template<typename T>
+class CompiledExpression;
+
+// Компиляция выражения. Если список переменных пуст, берутся все переменные
+// выражения в алфавитном порядке. Общие подвыражения вычисляются один раз.
+template<typename T>
+CompiledExpression<T> compile(const Expression<T>& expr, const std::vector<std::string>& variables = {});
+
+// Совместная компиляция набора выражений (например, градиента или якобиана):
+// подвыражения, общие для разных выражений, тоже вычисляются один раз
+template<typename T>
+CompiledExpression<T> compile(const std::vector<Expression<T>>& exprs,
+                              const std::vector<std::string>& variables = {});
+
+// Выражение, один раз переведённое в плоскую программу.
+// Регистры: [0, n) — переменные, затем константы, затем временные значения.
+template<typename T>
+class CompiledExpression {
+public:
+    // slots[i] — значение переменной variables()[i]; возвращается первый результат
+    T eval(const T* slots) const;
+    T eval(const std::map<std::string, T>& vars) const;
+    // Все результаты: out[k] — значение k-го выражения
+    void evalAll(const T* slots, T* out) const;
+
+    // Значение и градиент обратным проходом (reverse mode): один прямой
+    // и один обратный проход по программе, grad[i] — производная первого
+    // результата по slots[i]
+    T gradient(const T* slots, T* grad) const;
+
+    const std::vector<std::string>& variables() const { return variables_; }
+    size_t slot(const std::string& variable) const;
+
+    const std::vector<T>& constants() const { return constants_; }
+    const std::vector<Instruction>& code() const { return code_; }
+    uint32_t registerCount() const { return registers_; }
+    uint32_t resultRegister() const { return results_.front(); }
+    const std::vector<uint32_t>& resultRegisters() const { return results_; }
+    size_t outputCount() const { return results_.size(); }
+
+private:
+    template<typename U>
+    friend CompiledExpression<U> compile(const std::vector<Expression<U>>& exprs,
+                                         const std::vector<std::string>& variables);
+
+    void forward(const T* slots, T* r) const;
+
+    std::vector<std::string> variables_;
+    std::vector<T> constants_;
+    std::vector<Instruction> code_;
+    uint32_t registers_ = 0;
+    std::vector<uint32_t> results_;
+};
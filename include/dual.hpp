@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cmath>
+#include <istream>
+#include <ostream>
+
+// Дуальное число a + b ε, ε² = 0. Вычисление выражения над Dual даёт значение
+// и производную по направлению, заданному производными переменных (forward mode).
+template<typename T>
+struct Dual {
+    T value;
+    T derivative;
+
+    Dual(const T& value = T(), const T& derivative = T()) : value(value), derivative(derivative) {}
+};
+
+// Гипердуальное число a + b ε1 + c ε2 + d ε1ε2, ε1² = ε2² = 0: точные вторые
+// производные. При ε1 = ε2 = направление v коэффициент при ε1ε2 — это vᵀ H v.
+template<typename T>
+struct HyperDual {
+    T value;
+    T d1;
+    T d2;
+    T d12;
+
+    HyperDual(const T& value = T(), const T& d1 = T(), const T& d2 = T(), const T& d12 = T())
+        : value(value), d1(d1), d2(d2), d12(d12) {}
+};
+
+// ===== Dual =====
+
+template<typename T>
+bool operator==(const Dual<T>& a, const Dual<T>& b) { return a.value == b.value && a.derivative == b.derivative; }
+template<typename T>
+bool operator!=(const Dual<T>& a, const Dual<T>& b) { return !(a == b); }
+
+template<typename T>
+Dual<T> operator-(const Dual<T>& a) { return {-a.value, -a.derivative}; }
+template<typename T>
+Dual<T> operator+(const Dual<T>& a, const Dual<T>& b) { return {a.value + b.value, a.derivative + b.derivative}; }
+template<typename T>
+Dual<T> operator-(const Dual<T>& a, const Dual<T>& b) { return {a.value - b.value, a.derivative - b.derivative}; }
+template<typename T>
+Dual<T> operator*(const Dual<T>& a, const Dual<T>& b) {
+    return {a.value * b.value, a.derivative * b.value + a.value * b.derivative};
+}
+template<typename T>
+Dual<T> operator/(const Dual<T>& a, const Dual<T>& b) {
+    return {a.value / b.value, (a.derivative * b.value - a.value * b.derivative) / (b.value * b.value)};
+}
+
+template<typename T>
+Dual<T>& operator+=(Dual<T>& a, const Dual<T>& b) { return a = a + b; }
+template<typename T>
+Dual<T>& operator-=(Dual<T>& a, const Dual<T>& b) { return a = a - b; }
+
+template<typename T>
+Dual<T> sin(const Dual<T>& a) { return {std::sin(a.value), a.derivative * std::cos(a.value)}; }
+template<typename T>
+Dual<T> cos(const Dual<T>& a) { return {std::cos(a.value), -a.derivative * std::sin(a.value)}; }
+template<typename T>
+Dual<T> log(const Dual<T>& a) { return {std::log(a.value), a.derivative / a.value}; }
+template<typename T>
+Dual<T> exp(const Dual<T>& a) {
+    T e = std::exp(a.value);
+    return {e, a.derivative * e};
+}
+template<typename T>
+Dual<T> pow(const Dual<T>& a, const Dual<T>& b) {
+    T p = std::pow(a.value, b.value);
+    // Постоянный показатель: правило степени, допускает отрицательное основание
+    if (b.derivative == T(0)) {
+        if (b.value == T(0)) return {p, T(0)};
+        return {p, a.derivative * b.value * std::pow(a.value, b.value - T(1))};
+    }
+    return {p, p * (b.derivative * std::log(a.value) + b.value * a.derivative / a.value)};
+}
+
+template<typename T>
+std::ostream& operator<<(std::ostream& os, const Dual<T>& a) {
+    os << a.value;
+    if (a.derivative != T(0)) os << "+" << a.derivative << "eps";
+    return os;
+}
+
+template<typename T>
+std::istream& operator>>(std::istream& is, Dual<T>& a) {
+    T value;
+    if (is >> value) a = Dual<T>(value);
+    return is;
+}
+
+// ===== HyperDual =====
+
+// Применение скалярной функции f со значением f0 и производными f1, f2
+template<typename T>
+HyperDual<T> chain(const HyperDual<T>& a, const T& f0, const T& f1, const T& f2) {
+    return {f0, a.d1 * f1, a.d2 * f1, a.d12 * f1 + a.d1 * a.d2 * f2};
+}
+
+template<typename T>
+bool operator==(const HyperDual<T>& a, const HyperDual<T>& b) {
+    return a.value == b.value && a.d1 == b.d1 && a.d2 == b.d2 && a.d12 == b.d12;
+}
+template<typename T>
+bool operator!=(const HyperDual<T>& a, const HyperDual<T>& b) { return !(a == b); }
+
+template<typename T>
+HyperDual<T> operator-(const HyperDual<T>& a) { return {-a.value, -a.d1, -a.d2, -a.d12}; }
+template<typename T>
+HyperDual<T> operator+(const HyperDual<T>& a, const HyperDual<T>& b) {
+    return {a.value + b.value, a.d1 + b.d1, a.d2 + b.d2, a.d12 + b.d12};
+}
+template<typename T>
+HyperDual<T> operator-(const HyperDual<T>& a, const HyperDual<T>& b) {
+    return {a.value - b.value, a.d1 - b.d1, a.d2 - b.d2, a.d12 - b.d12};
+}
+template<typename T>
+HyperDual<T> operator*(const HyperDual<T>& a, const HyperDual<T>& b) {
+    return {a.value * b.value,
+            a.d1 * b.value + a.value * b.d1,
+            a.d2 * b.value + a.value * b.d2,
+            a.d12 * b.value + a.d1 * b.d2 + a.d2 * b.d1 + a.value * b.d12};
+}
+template<typename T>
+HyperDual<T> operator/(const HyperDual<T>& a, const HyperDual<T>& b) {
+    T inv = T(1) / b.value;
+    return a * chain(b, inv, -inv * inv, T(2) * inv * inv * inv);
+}
+
+template<typename T>
+HyperDual<T>& operator+=(HyperDual<T>& a, const HyperDual<T>& b) { return a = a + b; }
+template<typename T>
+HyperDual<T>& operator-=(HyperDual<T>& a, const HyperDual<T>& b) { return a = a - b; }
+
+template<typename T>
+HyperDual<T> sin(const HyperDual<T>& a) {
+    T s = std::sin(a.value);
+    return chain(a, s, std::cos(a.value), -s);
+}
+template<typename T>
+HyperDual<T> cos(const HyperDual<T>& a) {
+    T c = std::cos(a.value);
+    return chain(a, c, -std::sin(a.value), -c);
+}
+template<typename T>
+HyperDual<T> log(const HyperDual<T>& a) {
+    T inv = T(1) / a.value;
+    return chain(a, std::log(a.value), inv, -inv * inv);
+}
+template<typename T>
+HyperDual<T> exp(const HyperDual<T>& a) {
+    T e = std::exp(a.value);
+    return chain(a, e, e, e);
+}
+template<typename T>
+HyperDual<T> pow(const HyperDual<T>& a, const HyperDual<T>& b) {
+    if (b.d1 == T(0) && b.d2 == T(0) && b.d12 == T(0)) {
+        // Нулевой множитель n или n - 1 обнуляет член и в нуле основания,
+        // где pow с отрицательным показателем бесконечен (0 * inf = NaN)
+        T n = b.value;
+        T first = n == T(0) ? T(0) : n * std::pow(a.value, n - T(1));
+        T second = n == T(0) || n == T(1) ? T(0) : n * (n - T(1)) * std::pow(a.value, n - T(2));
+        return chain(a, std::pow(a.value, n), first, second);
+    }
+    return exp(b * log(a));
+}
+
+template<typename T>
+std::ostream& operator<<(std::ostream& os, const HyperDual<T>& a) {
+    os << a.value;
+    if (a.d1 != T(0)) os << "+" << a.d1 << "eps1";
+    if (a.d2 != T(0)) os << "+" << a.d2 << "eps2";
+    if (a.d12 != T(0)) os << "+" << a.d12 << "eps12";
+    return os;
+}
+
+template<typename T>
+std::istream& operator>>(std::istream& is, HyperDual<T>& a) {
+    T value;
+    if (is >> value) a = HyperDual<T>(value);
+    return is;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include "compiler.hpp"
+
+// JIT недоступен вне x86-64 с mmap или при сборке с -DSYMDIFF_NO_JIT
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__)) && !defined(SYMDIFF_NO_JIT)
+#define SYMDIFF_JIT 1
+#endif
+
+// Программа, переведённая в машинный код x86-64 (SSE2) в исполняемой странице.
+// Если JIT выключен или страницу получить не удалось, вызов исполняется
+// интерпретатором CompiledExpression.
+class JitFunction {
+public:
+    using Fn = double (*)(const double* slots);
+
+    explicit JitFunction(const CompiledExpression<double>& program);
+    explicit JitFunction(const Expression<double>& expr, const std::vector<std::string>& variables = {})
+        : JitFunction(compile(expr, variables)) {}
+    ~JitFunction();
+
+    JitFunction(JitFunction&& other) noexcept;
+    JitFunction& operator=(JitFunction&& other) noexcept;
+    JitFunction(const JitFunction&) = delete;
+    JitFunction& operator=(const JitFunction&) = delete;
+
+    double operator()(const double* slots) const {
+        return function_ ? function_(slots) : program_.eval(slots);
+    }
+
+    // Указатель на машинный код или nullptr, если используется интерпретатор
+    Fn function() const { return function_; }
+    bool native() const { return function_ != nullptr; }
+    size_t codeSize() const { return size_; }
+
+private:
+    void release();
+
+    CompiledExpression<double> program_;
+    std::vector<double> constants_;
+    void* memory_ = nullptr;
+    size_t size_ = 0;
+    Fn function_ = nullptr;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Минимальный JSON для построчных протоколов CLI: разбор записей запросов
+// и формирование ответов. Порядок ключей объекта сохраняется.
+struct JsonValue {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    // Значение по ключу объекта или nullptr
+    const JsonValue* find(std::string_view key) const;
+};
+
+// Вложенность по умолчанию. Ограничение нужно и при разборе без рекурсии:
+// копирование и разрушение JsonValue рекурсивны
+constexpr size_t JsonMaxDepth = 256;
+
+// Разбор одного значения; лишние символы после него и вложенность массивов
+// и объектов глубже maxDepth — ошибка (std::runtime_error)
+JsonValue parseJson(std::string_view text, size_t maxDepth = JsonMaxDepth);
+
+// Вложенность JSON-запросов при ограничении глубины выражений maxDepth
+// (0 — без ограничения): не меньше двух уровней протокола и не больше JsonMaxDepth
+inline size_t jsonDepthFor(size_t maxDepth) {
+    return maxDepth == 0 ? JsonMaxDepth : std::clamp<size_t>(maxDepth, 2, JsonMaxDepth);
+}
+
+// Строка в кавычках с экранированием
+std::string jsonQuote(std::string_view text);
+
+// Число с точностью, достаточной для обратного чтения; не-числа — null
+std::string jsonNumber(double value);
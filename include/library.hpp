@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Expression.hpp"
+#include "compiler.hpp"
+#include "serialize.hpp"
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Файл библиотеки именованных выражений (версия 1):
+//
+//   LibraryHeader
+//   uint32_t nameOffsets[entries + 1]   — границы имён, имена отсортированы
+//   char     names[nameBytes]
+//   граф в формате serialize.hpp с выравниванием 8; корень i — выражение с именем i
+//
+// Все выражения библиотеки лежат в одном графе, общие подвыражения хранятся один раз.
+struct LibraryHeader {
+    char magic[4];        // "SDXL"
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t entries;
+    uint32_t nameBytes;
+    uint64_t graphOffset;
+    uint64_t graphSize;
+};
+
+// Библиотека, открытая через mmap только для чтения: при открытии проверяются
+// заголовки и таблицы, узлы строятся лишь для запрошенных выражений.
+// Страницы файла общие для всех процессов, открывших ту же библиотеку.
+// Методы потокобезопасны
+template<typename T>
+class ExpressionLibrary {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    explicit ExpressionLibrary(const std::string& path);
+    ~ExpressionLibrary();
+    ExpressionLibrary(const ExpressionLibrary&) = delete;
+    ExpressionLibrary& operator=(const ExpressionLibrary&) = delete;
+
+    size_t size() const { return header_->entries; }
+    std::string_view name(size_t index) const {
+        return std::string_view(names_ + nameOffsets_[index], nameOffsets_[index + 1] - nameOffsets_[index]);
+    }
+    // Номер выражения по имени (двоичный поиск) или npos
+    size_t find(std::string_view name) const;
+
+    // Выражение строится при первом обращении и кэшируется.
+    // По неизвестному имени бросает std::out_of_range
+    Expression<T> get(size_t index) const;
+    Expression<T> get(std::string_view name) const;
+    // Скомпилированная программа выражения с переменными в порядке по умолчанию
+    const CompiledExpression<T>& compiled(size_t index) const;
+    const CompiledExpression<T>& compiled(std::string_view name) const;
+
+    // Сколько выражений уже построено
+    size_t materialized() const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    std::vector<uint64_t> buffer_;  // копия файла там, где нет mmap
+
+    const LibraryHeader* header_ = nullptr;
+    const uint32_t* nameOffsets_ = nullptr;
+    const char* names_ = nullptr;
+    std::optional<SerializedGraph<T>> graph_;
+
+    mutable std::mutex mutex_;
+    mutable std::unordered_map<size_t, Expression<T>> expressions_;
+    mutable std::unordered_map<size_t, CompiledExpression<T>> programs_;
+
+    size_t indexOf(std::string_view name) const;
+};
+
+// Запись библиотеки; имена должны быть уникальны
+template<typename T>
+void saveLibrary(const std::string& path, std::vector<std::pair<std::string, Expression<T>>> entries);
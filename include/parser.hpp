@@ -1,27 +1,111 @@
 #ifndef PARSER_HPP
 #define PARSER_HPP
 
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 #include "Expression.hpp"
 
-template<typename T>
-class Parser {
+// Ошибка разбора с позицией: смещение в байтах от начала входа,
+// строка и столбец считаются с 1. what() — "сообщение at line L, column C".
+class ParseError : public std::runtime_error {
 public:
-    explicit Parser(const std::string& input);
-    Expression<T> parse();
+    ParseError(const std::string& message, size_t offset, size_t line, size_t column)
+        : std::runtime_error(message + " at line " + std::to_string(line) + ", column " + std::to_string(column)),
+          message_(message), offset_(offset), line_(line), column_(column) {}
+
+    // Строка и столбец вычисляются по входу, только когда ошибка уже случилась
+    static ParseError at(std::string_view input, size_t offset, const std::string& message) {
+        size_t line = 1;
+        size_t lineStart = 0;
+        for (size_t i = 0; i < offset && i < input.size(); ++i) {
+            if (input[i] == '\n') {
+                ++line;
+                lineStart = i + 1;
+            }
+        }
+        return ParseError(message, offset, line, offset - lineStart + 1);
+    }
+
+    const std::string& message() const { return message_; }
+    size_t offset() const { return offset_; }
+    size_t line() const { return line_; }
+    size_t column() const { return column_; }
 
 private:
-    std::string input_;
-    size_t pos_;
+    std::string message_;
+    size_t offset_;
+    size_t line_;
+    size_t column_;
+};
+
+// Таблица операций парсера. Чем больше precedence, тем сильнее связывает
+// операция; стандартная таблица:
+//   + -  10, левые      * /  20, левые      унарный -  30      ^  40, правая
+// Пользовательские операции выражаются через существующие узлы, например
+// addInfix("**", 40, Associativity::Right, pow). Знак операции — либо слово
+// из букв (только инфиксное: "x mod y"), либо знаки препинания кроме скобок.
+template<typename T>
+class OperatorTable {
+public:
+    using Unary = std::function<Expression<T>(const Expression<T>&)>;
+    using Binary = std::function<Expression<T>(const Expression<T>&, const Expression<T>&)>;
+
+    enum class Associativity { Left, Right };
 
-    char peek() const;
-    char get();
-    void skipWhitespace();
+    struct Infix {
+        std::string symbol;
+        int precedence;
+        Associativity associativity;
+        Binary build;
+    };
+    struct Prefix {
+        std::string symbol;
+        int precedence;
+        Unary build;
+    };
+    struct Function {
+        std::string name;
+        Unary build;
+    };
 
-    Expression<T> parseExpression();
-    Expression<T> parseTerm();
-    Expression<T> parseFactor();
-    Expression<T> parsePrimary();
+    // Пустая таблица; стандартные операции и функции — в standard()
+    OperatorTable() = default;
+    static const OperatorTable& standard();
+
+    // Повторная регистрация заменяет прежнюю запись. Неверный знак
+    // или precedence <= 0 — std::invalid_argument
+    void addInfix(std::string symbol, int precedence, Associativity associativity, Binary build);
+    void addPrefix(std::string symbol, int precedence, Unary build);
+    void addFunction(std::string name, Unary build);
+
+    const Infix* infix(std::string_view symbol) const;
+    const Prefix* prefix(std::string_view symbol) const;
+    const Function* function(std::string_view name) const;
+
+    // Знаки, которые лексер должен распознавать сверх встроенных + - * / ^,
+    // от длинных к коротким
+    const std::vector<std::string>& symbols() const { return symbols_; }
+
+private:
+    std::vector<Infix> infix_;
+    std::vector<Prefix> prefix_;
+    // Номер записи + 1 для однобуквенных знаков: поиск без сравнения строк
+    unsigned char infixByChar_[128] = {};
+    unsigned char prefixByChar_[128] = {};
+    std::vector<Function> functions_;
+    std::vector<std::string> symbols_;
+
+    void addSymbol(const std::string& symbol, bool allowWord);
 };
 
+// Разбор с пользовательской таблицей операций. Ошибки — ParseError
+template<typename T>
+Expression<T> parseExpression(std::string_view input, const OperatorTable<T>& operators,
+                              const ParseLimits& limits = ParseLimits());
+
 #endif // PARSER_HPP
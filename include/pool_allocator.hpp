@@ -0,0 +1,175 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include "stats.hpp"
+
+// Пул блоков одного размера. Память берётся у системы плитами по 64 КБ,
+// блоки нарезаются из плиты сдвигом указателя, освобождённые блоки
+// переиспользуются через список. Плиты не возвращаются системе: узлы
+// разделяются между выражениями и могут жить до конца программы.
+// У каждого потока своя текущая плита и свой список свободных блоков, так что
+// потоки, параллельно строящие выражения, не делят блокировку. Под мьютексом
+// только общий список: в него уходят излишки локального списка и остатки
+// завершившегося потока, из него поток пополняется раньше, чем берёт плиту.
+template<std::size_t Size, std::size_t Align>
+class BlockPool {
+public:
+    void* allocate() {
+        Cache& cache = local();
+        if (cache.free) {
+            FreeBlock* block = cache.free;
+            cache.free = block->next;
+            --cache.count;
+            return block;
+        }
+        if (cache.retired) return allocateShared();
+        if (cache.cursor == cache.end) refill(cache);
+        if (cache.free) return allocate();
+        void* block = cache.cursor;
+        cache.cursor += BlockSize;
+        return block;
+    }
+
+    void deallocate(void* pointer) {
+        Cache& cache = local();
+        if (cache.retired) {
+            // Поток уже завершается: блок сразу уходит в общий список
+            std::lock_guard<std::mutex> lock(mutex_);
+            free_ = new (pointer) FreeBlock{free_};
+            return;
+        }
+        cache.free = new (pointer) FreeBlock{cache.free};
+        if (++cache.count == 1) registerExit();
+        if (cache.count > MaxLocalFree) release(cache);
+    }
+
+    static BlockPool& instance() {
+        static BlockPool* pool = new BlockPool;
+        return *pool;
+    }
+
+private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    // Без деструктора: к кэшу можно обратиться и после выхода потока
+    // из своих thread_local-деструкторов (например, при разрушении статических выражений)
+    struct Cache {
+        FreeBlock* free = nullptr;
+        std::size_t count = 0;
+        char* cursor = nullptr;
+        char* end = nullptr;
+        bool retired = false;
+    };
+
+    // Отдаёт кэш потока в общий список при завершении потока
+    struct ExitHook {
+        ~ExitHook() { instance().retire(local()); }
+    };
+
+    static constexpr std::size_t BlockAlign = Align > alignof(FreeBlock) ? Align : alignof(FreeBlock);
+    static constexpr std::size_t BlockSize = (std::max(Size, sizeof(FreeBlock)) + BlockAlign - 1) / BlockAlign * BlockAlign;
+    static constexpr std::size_t SlabSize = 64 * 1024;
+    static constexpr std::size_t MaxLocalFree = 2 * SlabSize / BlockSize;
+
+    static Cache& local() {
+        thread_local Cache cache;
+        return cache;
+    }
+
+    static void registerExit() {
+        thread_local ExitHook hook;
+        (void)hook;
+    }
+
+    // Локальные блоки кончились: общий список целиком или новая плита
+    void refill(Cache& cache) {
+        registerExit();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            while (free_ && cache.count < MaxLocalFree) {
+                FreeBlock* block = free_;
+                free_ = block->next;
+                cache.free = new (block) FreeBlock{cache.free};
+                ++cache.count;
+            }
+        }
+        if (!cache.free) cache.cursor = newSlab(cache.end);
+    }
+
+    // После завершения потока блоки берутся прямо из общего списка
+    void* allocateShared() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_) {
+            char* end = nullptr;
+            for (char* block = newSlab(end); block != end; block += BlockSize) {
+                free_ = new (block) FreeBlock{free_};
+            }
+        }
+        FreeBlock* block = free_;
+        free_ = block->next;
+        return block;
+    }
+
+    static char* newSlab(char*& end) {
+        SYMDIFF_COUNT(SlabAllocations);
+        char* slab = static_cast<char*>(::operator new(SlabSize, std::align_val_t(BlockAlign)));
+        end = slab + SlabSize / BlockSize * BlockSize;
+        return slab;
+    }
+
+    // Излишки локального списка — в общий
+    void release(Cache& cache) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (cache.free) {
+            FreeBlock* block = cache.free;
+            cache.free = block->next;
+            free_ = new (block) FreeBlock{free_};
+        }
+        cache.count = 0;
+    }
+
+    // Свободные блоки и остаток плиты завершившегося потока
+    void retire(Cache& cache) {
+        while (cache.cursor != cache.end) {
+            cache.free = new (cache.cursor) FreeBlock{cache.free};
+            cache.cursor += BlockSize;
+        }
+        release(cache);
+        cache.retired = true;
+    }
+
+    std::mutex mutex_;
+    FreeBlock* free_ = nullptr;
+};
+
+// Аллокатор поверх BlockPool для одиночных объектов: узлов выражений
+// (вместе со счётчиком ссылок allocate_shared) и элементов хэш-таблиц
+template<typename U>
+struct PoolAllocator {
+    using value_type = U;
+
+    PoolAllocator() = default;
+    template<typename V>
+    PoolAllocator(const PoolAllocator<V>&) {}
+
+    U* allocate(std::size_t n) {
+        if (n != 1) return std::allocator<U>().allocate(n);
+        return static_cast<U*>(BlockPool<sizeof(U), alignof(U)>::instance().allocate());
+    }
+
+    void deallocate(U* pointer, std::size_t n) {
+        if (n != 1) return std::allocator<U>().deallocate(pointer, n);
+        BlockPool<sizeof(U), alignof(U)>::instance().deallocate(pointer);
+    }
+
+    template<typename V>
+    bool operator==(const PoolAllocator<V>&) const { return true; }
+    template<typename V>
+    bool operator!=(const PoolAllocator<V>&) const { return false; }
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Expression.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Двоичный формат графа выражений (версия 1). Все секции выровнены на 8 байт,
+// записи фиксированной длины, поэтому файл читается прямо из отображения
+// в память, без разбора текста:
+//
+//   SerializedHeader
+//   uint32_t nameOffsets[symbols + 1]   — границы имён в блоке имён
+//   char     names[nameBytes]           — имена переменных подряд, без нулей
+//   T        constants[constants]       — значения констант как есть (IEEE 754)
+//   SerializedNode nodes[nodes]         — операнды всегда раньше узла
+//   uint32_t roots[roots]               — номера узлов-результатов
+//
+// Общие подвыражения хранятся один раз, повторные вхождения — ссылки по номеру.
+struct SerializedHeader {
+    char magic[4];        // "SDXG"
+    uint16_t version;
+    uint8_t scalar;       // тип значений: 1 double, 2 complex, 3 Dual, 4 HyperDual
+    uint8_t scalarSize;   // sizeof(T)
+    uint32_t byteOrder;   // 0x01020304 в порядке байт записавшей машины
+    uint32_t symbols;
+    uint32_t nameBytes;
+    uint32_t constants;
+    uint32_t nodes;
+    uint32_t roots;
+};
+
+// Узел: kind — NodeKind; для константы a — номер константы, для переменной —
+// номер символа, для операций a и b — номера операндов (b у унарных не используется)
+struct SerializedNode {
+    uint32_t kind;
+    uint32_t a;
+    uint32_t b;
+};
+
+// Проверенное представление сериализованного графа поверх чужого буфера.
+// Буфер не копируется и должен жить дольше представления
+template<typename T>
+class SerializedGraph {
+public:
+    // Бросает std::runtime_error, если буфер не является корректным графом
+    explicit SerializedGraph(std::string_view bytes);
+
+    const SerializedHeader& header() const { return *header_; }
+    size_t nodeCount() const { return header_->nodes; }
+    size_t rootCount() const { return header_->roots; }
+    const SerializedNode& node(size_t index) const { return nodes_[index]; }
+    uint32_t root(size_t index) const { return roots_[index]; }
+    const T& constant(size_t index) const { return constants_[index]; }
+    std::string_view symbolName(size_t index) const {
+        return std::string_view(names_ + nameOffsets_[index], nameOffsets_[index + 1] - nameOffsets_[index]);
+    }
+
+    // Построение выражений всех корней
+    std::vector<Expression<T>> expressions() const;
+    // Построение одного корня: затрагиваются только узлы его подграфа
+    Expression<T> expression(size_t root) const;
+
+private:
+    const SerializedHeader* header_;
+    const uint32_t* nameOffsets_;
+    const char* names_;
+    const T* constants_;
+    const SerializedNode* nodes_;
+    const uint32_t* roots_;
+};
+
+// Сериализация нескольких выражений в один граф с общими подвыражениями
+template<typename T>
+std::string serializeExpressions(const std::vector<Expression<T>>& roots);
+
+template<typename T>
+std::vector<Expression<T>> deserializeExpressions(std::string_view bytes);
+
+// Запись в файл и чтение через отображение файла в память
+template<typename T>
+void saveExpressions(const std::string& path, const std::vector<Expression<T>>& roots);
+
+template<typename T>
+std::vector<Expression<T>> loadExpressions(const std::string& path);
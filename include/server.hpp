@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "Expression.hpp"
+#include "compiler.hpp"
+
+// Сервер выражений с построчным JSON-протоколом. Разобранные выражения и их
+// скомпилированные программы хранятся между запросами под дескрипторами:
+//   {"op":"parse","expression":"x*y"}              -> {"handle":1,"expression":"(x * y)","variables":["x","y"]}
+//   {"op":"diff","handle":1,"variable":"x"}         -> {"handle":2,"expression":"y","variables":["y"]}
+//   {"op":"eval","handle":1,"bindings":{"x":2,"y":3}}      -> {"value":6}
+//   {"op":"gradient","handle":1,"bindings":{"x":2,"y":3}}  -> {"value":6,"gradient":{"x":3,"y":2}}
+//   {"op":"release","handle":1}                     -> {"released":true}
+// Вместо handle можно передать expression. Каждый ответ с handle (parse, diff)
+// даёт клиенту ссылку на дескриптор, release снимает одну ссылку; дескриптор
+// удаляется, когда ссылок не осталось. Так клиенты, разобравшие одно и то же
+// выражение, не мешают друг другу. eval и gradient по expression дескриптор
+// не создают. Ошибка — {"error":"..."}, ошибка разбора выражения
+// дополнительно содержит "offset", "line" и "column".
+// Строка запроса на сокете не длиннее 1 МиБ: на более длинную приходит
+// ошибка, и соединение закрывается.
+// Методы потокобезопасны.
+class ExpressionServer {
+public:
+    // limits ограничивают глубину и размер выражений из запросов
+    explicit ExpressionServer(const ParseLimits& limits = ParseLimits()) : limits_(limits) {}
+
+    // Один запрос — одна строка JSON, ответ — одна строка JSON без перевода строки
+    std::string handle(std::string_view request);
+
+    // Число живых дескрипторов
+    size_t handles() const;
+
+private:
+    struct Entry {
+        uint64_t handle;
+        Expression<double> expr;
+        CompiledExpression<double> program;
+    };
+
+    struct Slot {
+        std::shared_ptr<const Entry> entry;
+        size_t references;
+    };
+
+    // Дескриптор выражения с новой ссылкой на него
+    std::shared_ptr<const Entry> intern(const Expression<double>& expr);
+    // Запись существующего дескриптора или временная, без дескриптора
+    std::shared_ptr<const Entry> transient(const Expression<double>& expr) const;
+    // acquire — добавить ссылку на дескриптор
+    std::shared_ptr<const Entry> lookup(uint64_t handle, bool acquire);
+    // Снимает ссылку; false — дескриптора нет
+    bool release(uint64_t handle);
+
+    ParseLimits limits_;
+    mutable std::mutex mutex_;
+    std::unordered_map<uint64_t, Slot> entries_;
+    // Структурно равные выражения получают один дескриптор
+    std::unordered_map<const void*, uint64_t> byNode_;
+    uint64_t nextHandle_ = 1;
+};
+
+// JSON-запись пакетного режима {"expression":..., "variable":..., "bindings":{...}}:
+// ответ — объект с derivative (или expression) и value при заданных bindings,
+// либо {"error":"..."}. Значения bindings должны быть числами.
+std::string processRecord(std::string_view record, const ParseLimits& limits = ParseLimits());
+
+// Принимает соединения на Unix-сокете path и обслуживает каждое в своём потоке,
+// одновременно — не больше 64 соединений, остальные ждут в очереди.
+// Сокет, оставшийся на path, заменяется; другой файл на path — ошибка.
+// Не возвращается; ошибки сокета — std::runtime_error.
+void serveUnixSocket(const std::string& path, ExpressionServer& server);
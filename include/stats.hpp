@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Счётчики и таймеры горячих путей. Собираются только при сборке
+// с -DSYMDIFF_STATS: без него макросы SYMDIFF_* ниже пустые.
+// Каждый поток пишет в свой блок без блокировок и атомарных RMW-операций,
+// Stats::snapshot() суммирует блоки всех потоков.
+
+enum class Counter {
+    NodesCreated,           // новые узлы в таблице узлов
+    NodesReused,            // найден уже существующий структурно равный узел
+    SlabAllocations,        // плиты, взятые пулом узлов у системы
+    DerivativeCacheHits,
+    DerivativeCacheMisses,
+    TokensRead,
+    MaxStackDepth,          // глубина явного стека обхода; максимум, а не сумма
+    Count
+};
+
+// Время включает вложенные замеры (differentiate содержит simplify)
+enum class Timer {
+    Parse,
+    Differentiate,
+    Simplify,
+    Evaluate,
+    Substitute,
+    Compile,
+    Count
+};
+
+class Stats {
+public:
+    static constexpr size_t CounterCount = static_cast<size_t>(Counter::Count);
+    static constexpr size_t TimerCount = static_cast<size_t>(Timer::Count);
+
+    struct Snapshot {
+        uint64_t counters[CounterCount] = {};
+        uint64_t calls[TimerCount] = {};
+        uint64_t nanoseconds[TimerCount] = {};
+    };
+
+    // Собрана ли программа со статистикой
+    static constexpr bool enabled() {
+#ifdef SYMDIFF_STATS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static void add(Counter counter, uint64_t n = 1) {
+        bump(local().counters[index(counter)], n);
+    }
+    static void maximum(Counter counter, uint64_t value) {
+        std::atomic<uint64_t>& slot = local().counters[index(counter)];
+        if (value > slot.load(std::memory_order_relaxed)) slot.store(value, std::memory_order_relaxed);
+    }
+    static void record(Timer timer, uint64_t nanoseconds) {
+        Block& block = local();
+        bump(block.calls[index(timer)], 1);
+        bump(block.nanoseconds[index(timer)], nanoseconds);
+    }
+
+    // Сумма по всем потокам, включая завершившиеся
+    static Snapshot snapshot();
+    static void reset();
+
+    static const char* name(Counter counter);
+    static const char* name(Timer timer);
+    // Текстовая таблица и JSON-объект {"counters":{...},"timers":{...}}
+    static std::string report();
+    static std::string json();
+
+private:
+    struct Block {
+        std::atomic<uint64_t> counters[CounterCount] = {};
+        std::atomic<uint64_t> calls[TimerCount] = {};
+        std::atomic<uint64_t> nanoseconds[TimerCount] = {};
+    };
+
+    template<typename E>
+    static size_t index(E e) { return static_cast<size_t>(e); }
+
+    // В блок пишет только его поток: хватает load + store без lock-префикса
+    static void bump(std::atomic<uint64_t>& slot, uint64_t n) {
+        slot.store(slot.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static Block& local() {
+        thread_local Block* block = registerBlock();
+        return *block;
+    }
+    static Block* registerBlock();
+    static std::vector<Block*>& blocks();
+};
+
+// Время жизни объекта попадает в таймер
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Timer timer) : timer_(timer), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        Stats::record(timer_, static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Timer timer_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#define SYMDIFF_STATS_CONCAT_(a, b) a##b
+#define SYMDIFF_STATS_CONCAT(a, b) SYMDIFF_STATS_CONCAT_(a, b)
+
+#ifdef SYMDIFF_STATS
+#define SYMDIFF_COUNT(counter) Stats::add(Counter::counter)
+#define SYMDIFF_TIME(timer) ScopedTimer SYMDIFF_STATS_CONCAT(symdiffTimer, __LINE__)(Timer::timer)
+#define SYMDIFF_MAX(counter, value) Stats::maximum(Counter::counter, value)
+#else
+#define SYMDIFF_COUNT(counter) ((void)0)
+#define SYMDIFF_TIME(timer) ((void)0)
+#define SYMDIFF_MAX(counter, value) ((void)0)
+#endif
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Интернированное имя переменной: глобальная таблица символов выдаёт каждому
+// имени небольшой номер, поэтому сравнение и хэширование — сравнение чисел,
+// а значения переменных можно хранить в массиве по номеру символа
+class Symbol {
+public:
+    Symbol() = default;
+    explicit Symbol(std::string_view name);
+
+    uint32_t id() const { return id_; }
+    const std::string& name() const;
+    bool valid() const { return id_ != Invalid; }
+
+    bool operator==(Symbol other) const { return id_ == other.id_; }
+    bool operator!=(Symbol other) const { return id_ != other.id_; }
+
+    // Число интернированных имён: номера символов меньше него
+    static size_t count();
+
+private:
+    static constexpr uint32_t Invalid = UINT32_MAX;
+    uint32_t id_ = Invalid;
+};
+
+// Значения по номеру символа для одного вызова. Номера глобальные и не
+// освобождаются, поэтому массив до наибольшего номера рос бы с числом всех
+// когда-либо интернированных имён. Пока заданные номера лежат плотно, значения
+// хранятся в массиве от наименьшего из них, иначе — в векторе пар,
+// упорядоченном по номеру, с двоичным поиском.
+template<typename V>
+class SymbolMap {
+public:
+    void set(Symbol symbol, const V& value) {
+        const uint32_t id = symbol.id();
+        if (!sparse_) {
+            if (count_ == 0) {
+                base_ = id;
+                dense_.assign(1, value);
+                bound_.assign(1, true);
+                count_ = 1;
+                return;
+            }
+            const size_t low = std::min(base_, id);
+            const size_t high = std::max<size_t>(base_ + dense_.size(), size_t(id) + 1);
+            if (high - low <= std::max(DenseMin, DenseSlack * (count_ + 1))) {
+                if (id < base_) {
+                    dense_.insert(dense_.begin(), base_ - id, V());
+                    bound_.insert(bound_.begin(), base_ - id, false);
+                    base_ = id;
+                } else if (id - base_ >= dense_.size()) {
+                    dense_.resize(id - base_ + 1);
+                    bound_.resize(id - base_ + 1, false);
+                }
+                if (!bound_[id - base_]) ++count_;
+                bound_[id - base_] = true;
+                dense_[id - base_] = value;
+                return;
+            }
+            for (size_t i = 0; i < dense_.size(); ++i) {
+                if (bound_[i]) entries_.emplace_back(base_ + static_cast<uint32_t>(i), std::move(dense_[i]));
+            }
+            dense_ = {};
+            bound_ = {};
+            sparse_ = true;
+        }
+        auto it = std::lower_bound(entries_.begin(), entries_.end(), id,
+                                   [](const std::pair<uint32_t, V>& entry, uint32_t key) { return entry.first < key; });
+        if (it != entries_.end() && it->first == id) {
+            it->second = value;
+        } else {
+            entries_.emplace(it, id, value);
+            ++count_;
+        }
+    }
+
+    // Значение или nullptr, если номер не задан
+    const V* find(Symbol symbol) const {
+        const uint32_t id = symbol.id();
+        if (!sparse_) {
+            const size_t index = size_t(id) - base_;   // номер меньше base_ даёт большое число
+            return id >= base_ && index < bound_.size() && bound_[index] ? &dense_[index] : nullptr;
+        }
+        auto it = std::lower_bound(entries_.begin(), entries_.end(), id,
+                                   [](const std::pair<uint32_t, V>& entry, uint32_t key) { return entry.first < key; });
+        return it != entries_.end() && it->first == id ? &it->second : nullptr;
+    }
+
+    size_t size() const { return count_; }
+
+private:
+    // Плотный массив допускается, пока он не длиннее max(DenseMin, DenseSlack * size())
+    static constexpr size_t DenseMin = 64;
+    static constexpr size_t DenseSlack = 4;
+
+    bool sparse_ = false;
+    size_t count_ = 0;
+    uint32_t base_ = 0;
+    std::vector<V> dense_;
+    std::vector<bool> bound_;
+    std::vector<std::pair<uint32_t, V>> entries_;
+};
+
+// Значения переменных по номеру символа
+template<typename T>
+class Bindings {
+public:
+    Bindings() = default;
+    explicit Bindings(const std::map<std::string, T>& vars) {
+        for (const auto& [name, value] : vars) {
+            set(Symbol(name), value);
+        }
+    }
+
+    void set(Symbol symbol, const T& value) { values_.set(symbol, value); }
+
+    // Значение переменной или nullptr, если она не задана
+    const T* find(Symbol symbol) const { return values_.find(symbol); }
+
+private:
+    SymbolMap<T> values_;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул потоков с разбиением диапазона индексов и перехватом работы (work stealing).
+// Каждый поток получает свой непрерывный участок и берёт из него блоки по grain;
+// закончив, он забирает половину остатка у другого потока.
+class ThreadPool {
+public:
+    // threads == 0 — по числу аппаратных потоков; вызывающий поток тоже работает
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers_.size() + 1; }
+
+    // Выполняет body(begin, end) для блоков, покрывающих [0, count). Начало
+    // каждого блока кратно grain, короче grain бывает только блок, которым
+    // заканчивается диапазон.
+    // Возвращает управление, когда обработаны все блоки; первое исключение
+    // из body пробрасывается вызывающему.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+private:
+    struct Range {
+        std::mutex mutex;
+        size_t next = 0;
+        size_t end = 0;
+    };
+
+    void workerLoop(size_t index);
+    void runRanges(size_t index);
+    bool takeOwn(size_t index, size_t& begin, size_t& end);
+    bool steal(size_t index);
+
+    std::vector<std::thread> workers_;
+    std::unique_ptr<Range[]> ranges_;
+
+    std::mutex callMutex_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(size_t, size_t)>* body_ = nullptr;
+    size_t grain_ = 1;
+    uint64_t generation_ = 0;
+    size_t active_ = 0;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class TokenKind {
+    End,
+    Number,
+    Identifier,
+    Plus,
+    Minus,
+    Star,
+    Slash,
+    Caret,
+    LParen,
+    RParen,
+    Operator,    // знак, зарегистрированный в таблице операций
+    Invalid
+};
+
+// Лексема ссылается на исходный буфер, ничего не копируя
+struct Token {
+    TokenKind kind = TokenKind::End;
+    std::string_view text;
+    size_t offset = 0;   // позиция первого символа во входе
+    double number = 0;   // значение для TokenKind::Number
+};
+
+// Лексический анализатор поверх string_view: одна лексема предпросмотра,
+// пробелы пропускаются один раз при переходе к следующей лексеме,
+// числа читаются std::from_chars. Вход должен жить, пока живут лексемы.
+// symbols — дополнительные знаки операций от длинных к коротким; они
+// проверяются раньше встроенных, так что "**" не распадается на два "*".
+class Tokenizer {
+public:
+    explicit Tokenizer(std::string_view input, const std::vector<std::string>* symbols = nullptr)
+        : input_(input), symbols_(symbols) {
+        advance();
+    }
+
+    std::string_view input() const { return input_; }
+
+    const Token& peek() const { return current_; }
+
+    Token next() {
+        Token token = current_;
+        advance();
+        return token;
+    }
+
+    bool match(TokenKind kind) {
+        if (current_.kind != kind) return false;
+        advance();
+        return true;
+    }
+
+private:
+    void advance();
+    size_t matchSymbol() const;
+
+    std::string_view input_;
+    const std::vector<std::string>* symbols_;
+    size_t pos_ = 0;
+    Token current_;
+};
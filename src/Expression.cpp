@@ -1,115 +1,502 @@
 #include "../include/Expression.hpp"
+#include "../include/dual.hpp"
+#include "../include/pool_allocator.hpp"
+#include "../include/stats.hpp"
 #include <utility>
 #include <sstream>
+#include <stdexcept>
 #include <type_traits>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace {
 
-// Конструктор из значения
 template<typename T>
-Expression<T>::Expression(T value) {
+std::string formatValue(const T& value) {
     std::ostringstream oss;
     if constexpr (std::is_same_v<T, std::complex<double>>) {
         oss << "(" << value.real() << "+" << value.imag() << "i)";
     } else {
         oss << value;
     }
-    pImpl = std::make_unique<Impl>(oss.str());
+    return oss.str();
+}
+
+const char* binarySymbol(NodeKind kind) {
+    switch (kind) {
+        case NodeKind::Add: return " + ";
+        case NodeKind::Sub: return " - ";
+        case NodeKind::Mul: return " * ";
+        case NodeKind::Div: return " / ";
+        case NodeKind::Pow: return " ^ ";
+        default: return " ? ";
+    }
+}
+
+const char* functionName(NodeKind kind) {
+    switch (kind) {
+        case NodeKind::Sin: return "sin";
+        case NodeKind::Cos: return "cos";
+        case NodeKind::Ln:  return "ln";
+        case NodeKind::Exp: return "exp";
+        default: return "?";
+    }
+}
+
+template<typename Node>
+bool startsWithMinus(const Node* node) {
+    if (node->kind == NodeKind::Neg) return true;
+    return node->kind == NodeKind::Constant && formatValue(node->value)[0] == '-';
+}
+
+// Хэш и равенство констант по битовому представлению (различает 0 и -0)
+template<typename T>
+size_t hashValue(const T& value) {
+    static_assert(sizeof(T) % sizeof(uint64_t) == 0, "unexpected value layout");
+    uint64_t words[sizeof(T) / sizeof(uint64_t)];
+    std::memcpy(words, &value, sizeof(T));
+    size_t h = 0;
+    for (uint64_t w : words) {
+        h = h * 1000003u ^ std::hash<uint64_t>()(w);
+    }
+    return h;
+}
+
+template<typename T>
+bool sameValue(const T& a, const T& b) {
+    return std::memcmp(&a, &b, sizeof(T)) == 0;
+}
+
+// Таблица всех живых узлов одного типа T. Хранит только сырые указатели:
+// узлом владеют выражения, а деструктор узла вычёркивает его из таблицы.
+// Корзины связаны через поле chain самих узлов, поэтому вставка не выделяет память.
+// Таблица разбита на части со своими мьютексами: потоки, параллельно строящие
+// выражения, блокируют только часть, в которую попадает хэш узла.
+template<typename Node>
+class NodeTable {
+public:
+    template<typename Value>
+    std::shared_ptr<const Node> intern(NodeKind kind, const Value& value, Symbol symbol,
+                                       std::shared_ptr<const Node> lhs, std::shared_ptr<const Node> rhs,
+                                       size_t hash) {
+        const uint64_t mixed = mix(hash);
+        Shard& shard = shards_[mixed >> (64 - ShardBits)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const Node* node = shard.buckets[bucket(mixed, shard.buckets.size())]; node; node = node->chain) {
+            if (node->hash == hash && node->kind == kind && node->lhs == lhs && node->rhs == rhs
+                && sameValue(node->value, value) && node->symbol == symbol) {
+                // Узел может как раз удаляться в другом потоке
+                if (auto existing = node->weak_from_this().lock()) {
+                    SYMDIFF_COUNT(NodesReused);
+                    return existing;
+                }
+            }
+        }
+        SYMDIFF_COUNT(NodesCreated);
+        auto node = std::allocate_shared<const Node>(PoolAllocator<Node>(), kind, value, symbol,
+                                                     std::move(lhs), std::move(rhs), hash);
+        if (++shard.size > shard.buckets.size()) {
+            rehash(shard, shard.buckets.size() * 2);
+        }
+        const Node*& head = shard.buckets[bucket(mixed, shard.buckets.size())];
+        node->chain = head;
+        head = node.get();
+        return node;
+    }
+
+    void erase(const Node* node) {
+        const uint64_t mixed = mix(node->hash);
+        Shard& shard = shards_[mixed >> (64 - ShardBits)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        const Node** link = &shard.buckets[bucket(mixed, shard.buckets.size())];
+        while (*link && *link != node) {
+            link = &(*link)->chain;
+        }
+        if (*link) {
+            *link = node->chain;
+            --shard.size;
+        }
+    }
+
+    // Таблица не разрушается при выходе: её переживают статические выражения
+    static NodeTable& instance() {
+        static NodeTable* table = new NodeTable;
+        return *table;
+    }
+
+private:
+    static constexpr int ShardBits = 6;
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::vector<const Node*> buckets = std::vector<const Node*>(64, nullptr);  // степень двойки
+        size_t size = 0;
+    };
+
+    // Фибоначчиево хеширование: старшие биты произведения зависят от всех
+    // битов хэша (у целых констант и выровненных адресов младшие биты нулевые).
+    // Старшие ShardBits битов выбирают часть, следующие — корзину в ней
+    static uint64_t mix(size_t hash) {
+        return static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+    }
+
+    static size_t bucket(uint64_t mixed, size_t count) {
+        const int bits = __builtin_ctzll(count);
+        return static_cast<size_t>((mixed << ShardBits) >> (63 - bits) >> 1);
+    }
+
+    void rehash(Shard& shard, size_t count) {
+        std::vector<const Node*> buckets(count, nullptr);
+        for (const Node* head : shard.buckets) {
+            while (head) {
+                const Node* next = head->chain;
+                const Node*& slot = buckets[bucket(mix(head->hash), count)];
+                head->chain = slot;
+                slot = head;
+                head = next;
+            }
+        }
+        shard.buckets.swap(buckets);
+    }
+
+    Shard shards_[size_t(1) << ShardBits];
+};
+
+// Освобождение операндов без рекурсии: иначе разрушение длинной цепочки
+// узлов вызывает деструкторы вложенно и переполняет стек. Первый
+// разрушаемый узел заводит очередь и освобождает из неё по одному узлу;
+// деструкторы, вызванные при этом, только добавляют свои операнды в очередь
+template<typename Node>
+void releaseOperands(std::shared_ptr<const Node>& lhs, std::shared_ptr<const Node>& rhs) {
+    thread_local std::vector<std::shared_ptr<const Node>>* queue = nullptr;
+    if (queue) {
+        if (lhs) queue->push_back(std::move(lhs));
+        if (rhs) queue->push_back(std::move(rhs));
+        return;
+    }
+    // Очередь нужна, только если вместе с узлом умирает внутренний узел
+    auto dying = [](const std::shared_ptr<const Node>& child) {
+        return child && child->lhs && child.use_count() == 1;
+    };
+    if (!dying(lhs) && !dying(rhs)) return;
+
+    std::vector<std::shared_ptr<const Node>> pending;
+    queue = &pending;
+    if (lhs) pending.push_back(std::move(lhs));
+    if (rhs) pending.push_back(std::move(rhs));
+    while (!pending.empty()) {
+        std::shared_ptr<const Node> node = std::move(pending.back());
+        pending.pop_back();
+        node.reset();
+    }
+    queue = nullptr;
+}
+
+} // namespace
+
+template<typename T>
+Expression<T>::Impl::Impl(NodeKind kind, const T& value, Symbol symbol,
+                          std::shared_ptr<const Impl> lhs, std::shared_ptr<const Impl> rhs, size_t hash)
+    : kind(kind), value(value), symbol(symbol), lhs(std::move(lhs)), rhs(std::move(rhs)), hash(hash) {}
+
+template<typename T>
+Expression<T>::Impl::~Impl() {
+    NodeTable<Impl>::instance().erase(this);
+    releaseOperands(lhs, rhs);
+}
+
+// Единственная точка создания узлов
+template<typename T>
+std::shared_ptr<const typename Expression<T>::Impl>
+Expression<T>::makeNode(NodeKind kind, const T& value, Symbol symbol,
+                        std::shared_ptr<const Impl> lhs, std::shared_ptr<const Impl> rhs) {
+    size_t hash = static_cast<size_t>(kind);
+    hash = hash * 31 + hashValue(value);
+    hash = hash * 31 + symbol.id();
+    hash = hash * 31 + std::hash<const void*>()(lhs.get());
+    hash = hash * 31 + std::hash<const void*>()(rhs.get());
+    return NodeTable<Impl>::instance().intern(kind, value, symbol, std::move(lhs), std::move(rhs), hash);
 }
 
+// Конструктор из значения
+template<typename T>
+Expression<T>::Expression(T value)
+    : pImpl(makeNode(NodeKind::Constant, value, Symbol(), nullptr, nullptr)) {}
+
 template<typename T>
 Expression<T>::Expression(const std::string& variable)
-    : pImpl(std::make_unique<Impl>(variable)) {}
+    : Expression(Symbol(variable)) {}
 
+template<typename T>
+Expression<T>::Expression(Symbol variable)
+    : pImpl(makeNode(NodeKind::Variable, T(), variable, nullptr, nullptr)) {}
+
+// Копирование разделяет неизменяемое дерево
 template<typename T>
 Expression<T>::Expression(const Expression& other)
-    : pImpl(std::make_unique<Impl>(other.pImpl->expr)) {}
+    : pImpl(other.pImpl) {}
 
 
 template<typename T>
 Expression<T>& Expression<T>::operator=(const Expression& other) {
     if (this != &other) {
-        pImpl = std::make_unique<Impl>(other.pImpl->expr);
+        pImpl = other.pImpl;
     }
     return *this;
 }
 
+template<typename T>
+Expression<T>::Expression(std::shared_ptr<const Impl> node)
+    : pImpl(std::move(node)) {}
+
+template<typename T>
+Expression<T> Expression<T>::unary(NodeKind kind, const Expression& arg) {
+    return Expression(makeNode(kind, T(), Symbol(), arg.pImpl, nullptr));
+}
+
+template<typename T>
+Expression<T> Expression<T>::binary(NodeKind kind, const Expression& lhs, const Expression& rhs) {
+    return Expression(makeNode(kind, T(), Symbol(), lhs.pImpl, rhs.pImpl));
+}
+
 
 // Арифметические операторы
 
 template<typename T>
 Expression<T> Expression<T>::operator+(const Expression& rhs) const {
-    return Expression("(" + pImpl->expr + " + " + rhs.pImpl->expr + ")");
+    return binary(NodeKind::Add, *this, rhs);
 }
 
 template<typename T>
 Expression<T> Expression<T>::operator-(const Expression& rhs) const {
-    return Expression("(" + pImpl->expr + " - " + rhs.pImpl->expr + ")");
+    return binary(NodeKind::Sub, *this, rhs);
 }
 
 template<typename T>
 Expression<T> Expression<T>::operator*(const Expression& rhs) const {
-    return Expression("(" + pImpl->expr + " * " + rhs.pImpl->expr + ")");
+    return binary(NodeKind::Mul, *this, rhs);
 }
 
 template<typename T>
 Expression<T> Expression<T>::operator/(const Expression& rhs) const {
-    return Expression("(" + pImpl->expr + " / " + rhs.pImpl->expr + ")");
+    return binary(NodeKind::Div, *this, rhs);
 }
 
 template<typename T>
 Expression<T> Expression<T>::operator^(const Expression& rhs) const {
-    return Expression("(" + pImpl->expr + " ^ " + rhs.pImpl->expr + ")");
+    return binary(NodeKind::Pow, *this, rhs);
+}
+
+template<typename T>
+Expression<T> Expression<T>::operator-() const {
+    return unary(NodeKind::Neg, *this);
+}
+
+
+// Структура дерева
+
+template<typename T>
+NodeKind Expression<T>::kind() const {
+    return pImpl->kind;
+}
+
+template<typename T>
+const T& Expression<T>::value() const {
+    return pImpl->value;
+}
+
+template<typename T>
+const std::string& Expression<T>::name() const {
+    return pImpl->symbol.name();
+}
+
+template<typename T>
+Symbol Expression<T>::symbol() const {
+    return pImpl->symbol;
+}
+
+template<typename T>
+size_t Expression<T>::arity() const {
+    return pImpl->rhs ? 2 : (pImpl->lhs ? 1 : 0);
+}
+
+template<typename T>
+Expression<T> Expression<T>::operand(size_t index) const {
+    const auto& child = index == 0 ? pImpl->lhs : pImpl->rhs;
+    if (index >= 2 || !child) {
+        throw std::out_of_range("Operand index out of range");
+    }
+    return Expression(child);
+}
+
+
+// Печать дерева в строку: бинарные операции всегда в скобках
+
+template<typename T>
+void Expression<T>::print(const Impl* root, std::string& out) {
+    // Стек содержит узлы и строки, которые нужно вывести после них
+    struct Item {
+        const Impl* node;
+        const char* text;
+    };
+    std::vector<Item> stack = {{root, nullptr}};
+    while (!stack.empty()) {
+        Item item = stack.back();
+        stack.pop_back();
+        if (item.text) {
+            out += item.text;
+            continue;
+        }
+
+        const Impl* node = item.node;
+        switch (node->kind) {
+            case NodeKind::Constant:
+                out += formatValue(node->value);
+                break;
+            case NodeKind::Variable:
+                out += node->symbol.name();
+                break;
+            case NodeKind::Neg:
+                out += '-';
+                stack.push_back({node->lhs.get(), nullptr});
+                break;
+            case NodeKind::Sin:
+            case NodeKind::Cos:
+            case NodeKind::Ln:
+            case NodeKind::Exp:
+                out += functionName(node->kind);
+                out += '(';
+                stack.push_back({nullptr, ")"});
+                stack.push_back({node->lhs.get(), nullptr});
+                break;
+            default: {
+                // Основание степени со знаком минус берётся в скобки:
+                // -x ^ 2 читается как -(x ^ 2)
+                bool signedBase = node->kind == NodeKind::Pow && startsWithMinus(node->lhs.get());
+                out += signedBase ? "((" : "(";
+                stack.push_back({nullptr, ")"});
+                stack.push_back({node->rhs.get(), nullptr});
+                stack.push_back({nullptr, binarySymbol(node->kind)});
+                if (signedBase) stack.push_back({nullptr, ")"});
+                stack.push_back({node->lhs.get(), nullptr});
+                break;
+            }
+        }
+    }
 }
 
 template<typename T>
 std::string Expression<T>::toString() const {
-    return pImpl->expr;
+    std::string out;
+    print(pImpl.get(), out);
+    return out;
 }
+
+
+// Подстановка за один обход: перестраиваются только пути к заменённым
+// переменным, каждый общий узел DAG обрабатывается один раз
+
 template<typename T>
-Expression<T> Expression<T>::substitute(const std::string& var, const T& value) const {
-    std::ostringstream oss;
-    if constexpr (std::is_same_v<T, std::complex<double>>) {
-        oss << "(" << value.real() << "+" << value.imag() << "i)";
-    } else {
-        oss << value;
+std::shared_ptr<const typename Expression<T>::Impl>
+Expression<T>::substitute(const std::shared_ptr<const Impl>& root, const Replacements& replacements,
+                          SubstituteMemo& memo) {
+    // Листья заменяются сразу, внутренние узлы берутся из memo
+    auto resolved = [&](const std::shared_ptr<const Impl>& node) -> std::shared_ptr<const Impl> {
+        switch (node->kind) {
+            case NodeKind::Constant:
+                return node;
+            case NodeKind::Variable: {
+                const auto* replacement = replacements.find(node->symbol);
+                return replacement ? *replacement : node;
+            }
+            default:
+                return memo.at(node.get());
+        }
+    };
+    if (!root->lhs) return resolved(root);
+
+    // Обход в обратном порядке по явному стеку: узел перестраивается после операндов
+    std::vector<std::pair<const Impl*, bool>> stack = {{root.get(), false}};
+    while (!stack.empty()) {
+        auto [node, ready] = stack.back();
+        stack.pop_back();
+        if (memo.count(node)) continue;
+        if (!ready) {
+            stack.push_back({node, true});
+            if (node->rhs && node->rhs->lhs) stack.push_back({node->rhs.get(), false});
+            if (node->lhs->lhs) stack.push_back({node->lhs.get(), false});
+            continue;
+        }
+
+        auto lhs = resolved(node->lhs);
+        auto rhs = node->rhs ? resolved(node->rhs) : nullptr;
+        auto result = lhs == node->lhs && rhs == node->rhs
+                          ? node->shared_from_this()
+                          : makeNode(node->kind, node->value, node->symbol, std::move(lhs), std::move(rhs));
+        memo.emplace(node, std::move(result));
     }
+    return memo.at(root.get());
+}
 
-    std::string result = pImpl->expr;
-    size_t pos = 0;
-    while ((pos = result.find(var, pos)) != std::string::npos) {
-        result.replace(pos, var.length(), oss.str());
-        pos += oss.str().length();
+template<typename T>
+Expression<T> Expression<T>::substitute(const std::map<std::string, Expression>& replacements) const {
+    SYMDIFF_TIME(Substitute);
+    Replacements table;
+    for (const auto& [var, replacement] : replacements) {
+        table.set(Symbol(var), replacement.pImpl);
     }
+    SubstituteMemo memo;
+    return Expression(substitute(pImpl, table, memo));
+}
 
-    return Expression(result);
+template<typename T>
+Expression<T> Expression<T>::substitute(const std::string& var, const T& value) const {
+    return substitute({{var, Expression(value)}});
 }
 
 template<typename T>
 Expression<T> Expression<T>::substitute_all(const std::map<std::string, T>& vars) const {
-    Expression<T> result = *this;
-    for (const auto& [var, val] : vars) {
-        result = result.substitute(var, val);
+    std::map<std::string, Expression> replacements;
+    for (const auto& [var, value] : vars) {
+        replacements.emplace(var, Expression(value));
     }
-    return result;
+    return substitute(replacements);
 }
 
 // double
 template Expression<double>::Expression(double);
 template Expression<double>::Expression(const std::string&);
+template Expression<double>::Expression(Symbol);
 template Expression<double>::Expression(const Expression<double>&);
 template Expression<double>& Expression<double>::operator=(const Expression<double>&);
 
 // complex<double>
 template Expression<std::complex<double>>::Expression(std::complex<double>);
 template Expression<std::complex<double>>::Expression(const std::string&);
+template Expression<std::complex<double>>::Expression(Symbol);
 template Expression<std::complex<double>>::Expression(const Expression<std::complex<double>>&);
 template Expression<std::complex<double>>& Expression<std::complex<double>>::operator=(const Expression<std::complex<double>>&);
 
+// Построение узлов
+template Expression<double>::Expression(std::shared_ptr<const Expression<double>::Impl>);
+template Expression<double> Expression<double>::unary(NodeKind, const Expression<double>&);
+template Expression<double> Expression<double>::binary(NodeKind, const Expression<double>&, const Expression<double>&);
+
+template Expression<std::complex<double>>::Expression(std::shared_ptr<const Expression<std::complex<double>>::Impl>);
+template Expression<std::complex<double>> Expression<std::complex<double>>::unary(NodeKind, const Expression<std::complex<double>>&);
+template Expression<std::complex<double>> Expression<std::complex<double>>::binary(NodeKind, const Expression<std::complex<double>>&, const Expression<std::complex<double>>&);
+
 // Арифметика double
 template Expression<double> Expression<double>::operator+(const Expression<double>&) const;
 template Expression<double> Expression<double>::operator-(const Expression<double>&) const;
 template Expression<double> Expression<double>::operator*(const Expression<double>&) const;
 template Expression<double> Expression<double>::operator/(const Expression<double>&) const;
 template Expression<double> Expression<double>::operator^(const Expression<double>&) const;
+template Expression<double> Expression<double>::operator-() const;
 template std::string Expression<double>::toString() const;
 
 // Арифметика std::complex<double>
@@ -118,13 +505,81 @@ template Expression<std::complex<double>> Expression<std::complex<double>>::oper
 template Expression<std::complex<double>> Expression<std::complex<double>>::operator*(const Expression<std::complex<double>>&) const;
 template Expression<std::complex<double>> Expression<std::complex<double>>::operator/(const Expression<std::complex<double>>&) const;
 template Expression<std::complex<double>> Expression<std::complex<double>>::operator^(const Expression<std::complex<double>>&) const;
+template Expression<std::complex<double>> Expression<std::complex<double>>::operator-() const;
 template std::string Expression<std::complex<double>>::toString() const;
 
+// Структура дерева
+template NodeKind Expression<double>::kind() const;
+template const double& Expression<double>::value() const;
+template const std::string& Expression<double>::name() const;
+template Symbol Expression<double>::symbol() const;
+template size_t Expression<double>::arity() const;
+template Expression<double> Expression<double>::operand(size_t) const;
+
+template NodeKind Expression<std::complex<double>>::kind() const;
+template const std::complex<double>& Expression<std::complex<double>>::value() const;
+template const std::string& Expression<std::complex<double>>::name() const;
+template Symbol Expression<std::complex<double>>::symbol() const;
+template size_t Expression<std::complex<double>>::arity() const;
+template Expression<std::complex<double>> Expression<std::complex<double>>::operand(size_t) const;
+
 
 // Явные инстанцирования
 template Expression<double> Expression<double>::substitute_all(const std::map<std::string, double>&) const;
 template Expression<std::complex<double>> Expression<std::complex<double>>::substitute_all(const std::map<std::string, std::complex<double>>&) const;
 
 template Expression<double> Expression<double>::substitute(const std::string&, const double&) const;
+template Expression<double> Expression<double>::substitute(const std::map<std::string, Expression<double>>&) const;
 template Expression<std::complex<double>> Expression<std::complex<double>>::substitute(const std::string&, const std::complex<double>&) const;
+template Expression<std::complex<double>> Expression<std::complex<double>>::substitute(const std::map<std::string, Expression<std::complex<double>>>&) const;
+
+// Дуальные числа для вычисления производных по направлению (forward mode)
+template Expression<Dual<double>>::Expression(Dual<double>);
+template Expression<Dual<double>>::Expression(const std::string&);
+template Expression<Dual<double>>::Expression(Symbol);
+template Expression<Dual<double>>::Expression(const Expression<Dual<double>>&);
+template Expression<Dual<double>>& Expression<Dual<double>>::operator=(const Expression<Dual<double>>&);
+template Expression<Dual<double>>::Expression(std::shared_ptr<const Expression<Dual<double>>::Impl>);
+template Expression<Dual<double>> Expression<Dual<double>>::unary(NodeKind, const Expression<Dual<double>>&);
+template Expression<Dual<double>> Expression<Dual<double>>::binary(NodeKind, const Expression<Dual<double>>&, const Expression<Dual<double>>&);
+template Expression<Dual<double>> Expression<Dual<double>>::operator+(const Expression<Dual<double>>&) const;
+template Expression<Dual<double>> Expression<Dual<double>>::operator-(const Expression<Dual<double>>&) const;
+template Expression<Dual<double>> Expression<Dual<double>>::operator*(const Expression<Dual<double>>&) const;
+template Expression<Dual<double>> Expression<Dual<double>>::operator/(const Expression<Dual<double>>&) const;
+template Expression<Dual<double>> Expression<Dual<double>>::operator^(const Expression<Dual<double>>&) const;
+template Expression<Dual<double>> Expression<Dual<double>>::operator-() const;
+template std::string Expression<Dual<double>>::toString() const;
+template NodeKind Expression<Dual<double>>::kind() const;
+template const Dual<double>& Expression<Dual<double>>::value() const;
+template const std::string& Expression<Dual<double>>::name() const;
+template Symbol Expression<Dual<double>>::symbol() const;
+template size_t Expression<Dual<double>>::arity() const;
+template Expression<Dual<double>> Expression<Dual<double>>::operand(size_t) const;
+template Expression<Dual<double>> Expression<Dual<double>>::substitute(const std::string&, const Dual<double>&) const;
+template Expression<Dual<double>> Expression<Dual<double>>::substitute(const std::map<std::string, Expression<Dual<double>>>&) const;
+template Expression<Dual<double>> Expression<Dual<double>>::substitute_all(const std::map<std::string, Dual<double>>&) const;
 
+template Expression<HyperDual<double>>::Expression(HyperDual<double>);
+template Expression<HyperDual<double>>::Expression(const std::string&);
+template Expression<HyperDual<double>>::Expression(Symbol);
+template Expression<HyperDual<double>>::Expression(const Expression<HyperDual<double>>&);
+template Expression<HyperDual<double>>& Expression<HyperDual<double>>::operator=(const Expression<HyperDual<double>>&);
+template Expression<HyperDual<double>>::Expression(std::shared_ptr<const Expression<HyperDual<double>>::Impl>);
+template Expression<HyperDual<double>> Expression<HyperDual<double>>::unary(NodeKind, const Expression<HyperDual<double>>&);
+template Expression<HyperDual<double>> Expression<HyperDual<double>>::binary(NodeKind, const Expression<HyperDual<double>>&, const Expression<HyperDual<double>>&);
+template Expression<HyperDual<double>> Expression<HyperDual<double>>::operator+(const Expression<HyperDual<double>>&) const;
+template Expression<HyperDual<double>> Expression<HyperDual<double>>::operator-(const Expression<HyperDual<double>>&) const;
+template Expression<HyperDual<double>> Expression<HyperDual<double>>::operator*(const Expression<HyperDual<double>>&) const;
+template Expression<HyperDual<double>> Expression<HyperDual<double>>::operator/(const Expression<HyperDual<double>>&) const;
+template Expression<HyperDual<double>> Expression<HyperDual<double>>::operator^(const Expression<HyperDual<double>>&) const;
+template Expression<HyperDual<double>> Expression<HyperDual<double>>::operator-() const;
+template std::string Expression<HyperDual<double>>::toString() const;
+template NodeKind Expression<HyperDual<double>>::kind() const;
+template const HyperDual<double>& Expression<HyperDual<double>>::value() const;
+template const std::string& Expression<HyperDual<double>>::name() const;
+template Symbol Expression<HyperDual<double>>::symbol() const;
+template size_t Expression<HyperDual<double>>::arity() const;
+template Expression<HyperDual<double>> Expression<HyperDual<double>>::operand(size_t) const;
+template Expression<HyperDual<double>> Expression<HyperDual<double>>::substitute(const std::string&, const HyperDual<double>&) const;
+template Expression<HyperDual<double>> Expression<HyperDual<double>>::substitute(const std::map<std::string, Expression<HyperDual<double>>>&) const;
+template Expression<HyperDual<double>> Expression<HyperDual<double>>::substitute_all(const std::map<std::string, HyperDual<double>>&) const;
@@ -0,0 +1,239 @@
+#include "../include/batch.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Ядра внутренние для этого файла, поэтому предупреждение о смене ABI
+// при передаче широких векторов без -mavx512f не имеет значения
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+namespace {
+
+// Векторные типы GCC/Clang: при -mavx2 / -mavx512f компилятор раскладывает
+// их на соответствующие регистры, без флагов — на пары SSE2
+typedef double Vec __attribute__((vector_size(BatchLanes * sizeof(double))));
+typedef int64_t IVec __attribute__((vector_size(BatchLanes * sizeof(int64_t))));
+
+#define BATCH_INLINE inline __attribute__((always_inline))
+
+struct Lane {
+    Vec v;
+};
+
+BATCH_INLINE Vec broadcast(double x) {
+    Vec v;
+    for (size_t k = 0; k < BatchLanes; ++k) v[k] = x;
+    return v;
+}
+
+BATCH_INLINE Vec select(const IVec& mask, const Vec& a, const Vec& b) {
+    return (Vec)((mask & (IVec)a) | (~mask & (IVec)b));
+}
+
+// Округление к ближайшему целому через «магическую» константу 1.5 * 2^52
+constexpr double RoundMagic = 6755399441055744.0;
+
+BATCH_INLINE Vec roundNearest(const Vec& x) {
+    return (x + RoundMagic) - RoundMagic;
+}
+
+// 2^k для целых k в диапазоне нормальных чисел
+BATCH_INLINE Vec pow2(const IVec& k) {
+    return (Vec)((k + 1023) << 52);
+}
+
+BATCH_INLINE IVec toInt(const Vec& x) {
+    return __builtin_convertvector(x, IVec);
+}
+
+// ===== exp: x = k ln2 + r, |r| <= ln2 / 2 =====
+
+BATCH_INLINE Vec vexp(const Vec& x) {
+    const double ln2hi = 6.93147180369123816490e-01;
+    const double ln2lo = 1.90821492927058770002e-10;
+    const double log2e = 1.44269504088896338700e+00;
+
+    Vec xc = select(x > 709.8, broadcast(709.8), select(x < -745.2, broadcast(-745.2), x));
+    Vec kf = roundNearest(xc * log2e);
+    Vec r = (xc - kf * ln2hi) - kf * ln2lo;
+
+    // Тейлор до r^13: погрешность ниже 1e-17 на |r| <= 0.35
+    Vec p = broadcast(1.0 / 6227020800.0);
+    const double coeffs[] = {1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0, 1.0 / 362880.0,
+                             1.0 / 40320.0, 1.0 / 5040.0, 1.0 / 720.0, 1.0 / 120.0, 1.0 / 24.0,
+                             1.0 / 6.0, 0.5, 1.0, 1.0};
+    for (double c : coeffs) p = p * r + c;
+
+    // Масштаб делится на два множителя, чтобы покрыть субнормальные и 2^1024
+    IVec k = toInt(kf);
+    IVec k1 = k >> 1;
+    Vec result = p * pow2(k1) * pow2(k - k1);
+
+    result = select(x > 709.782712893384, broadcast(HUGE_VAL), result);
+    result = select(x < -745.1332191019412, broadcast(0.0), result);
+    return select(x != x, x, result);
+}
+
+// ===== ln: x = m * 2^e, m в [sqrt(1/2), sqrt(2)), ln(m) = 2 atanh((m - 1) / (m + 1)) =====
+
+BATCH_INLINE Vec vlog(const Vec& x) {
+    const double ln2hi = 6.93147180369123816490e-01;
+    const double ln2lo = 1.90821492927058770002e-10;
+
+    // Субнормальные числа сначала нормализуются
+    IVec tiny = x < 2.2250738585072014e-308;
+    Vec xs = select(tiny, x * 18014398509481984.0, x);  // 2^54
+    IVec bits = (IVec)xs;
+    IVec e = ((bits >> 52) & 0x7ff) - 1023 - (tiny & 54);
+    Vec m = (Vec)((bits & 0x000fffffffffffffLL) | 0x3ff0000000000000LL);
+    IVec big = m > 1.4142135623730951;
+    m = select(big, m * 0.5, m);
+    e = e - big;  // big == -1 в истинных дорожках
+
+    Vec s = (m - 1.0) / (m + 1.0);
+    Vec s2 = s * s;
+    Vec p = broadcast(1.0 / 25.0);
+    const double coeffs[] = {1.0 / 23.0, 1.0 / 21.0, 1.0 / 19.0, 1.0 / 17.0, 1.0 / 15.0, 1.0 / 13.0,
+                             1.0 / 11.0, 1.0 / 9.0, 1.0 / 7.0, 1.0 / 5.0, 1.0 / 3.0, 1.0};
+    for (double c : coeffs) p = p * s2 + c;
+
+    Vec ef = __builtin_convertvector(e, Vec);
+    Vec result = ef * ln2hi + (2.0 * s * p + ef * ln2lo);
+
+    result = select(x == 0.0, broadcast(-HUGE_VAL), result);
+    result = select(x < 0.0, broadcast(NAN), result);
+    result = select(x == HUGE_VAL, x, result);
+    return select(x != x, x, result);
+}
+
+// ===== sin/cos: x = q pi/2 + r, |r| <= pi/4 =====
+
+// Граница, до которой редукция Коди — Уэйта точна; дальше — std::sin/std::cos
+constexpr double TrigReductionLimit = 1e5;
+
+BATCH_INLINE void vsincos(const Vec& x, Vec* sinOut, Vec* cosOut) {
+    const double twoOverPi = 6.36619772367581382433e-01;
+    const double pio2_1  = 1.57079632673412561417e+00;
+    const double pio2_2  = 6.07710050630396597660e-11;
+    const double pio2_3  = 2.02226624871116645580e-21;
+    const double pio2_3t = 8.47842766036889956997e-32;
+
+    Vec q = roundNearest(x * twoOverPi);
+    Vec r = x - q * pio2_1;
+    r = r - q * pio2_2;
+    r = r - q * pio2_3;
+    r = r - q * pio2_3t;
+    Vec r2 = r * r;
+
+    Vec s = broadcast(1.0 / 355687428096000.0);  // 1/17!
+    const double sinCoeffs[] = {-1.0 / 1307674368000.0, 1.0 / 6227020800.0, -1.0 / 39916800.0,
+                                1.0 / 362880.0, -1.0 / 5040.0, 1.0 / 120.0, -1.0 / 6.0, 1.0};
+    for (double c : sinCoeffs) s = s * r2 + c;
+    s = s * r;
+
+    Vec c = broadcast(-1.0 / 6402373705728000.0);  // -1/18!
+    const double cosCoeffs[] = {1.0 / 20922789888000.0, -1.0 / 87178291200.0, 1.0 / 479001600.0,
+                                -1.0 / 3628800.0, 1.0 / 40320.0, -1.0 / 720.0, 1.0 / 24.0, -0.5, 1.0};
+    for (double k : cosCoeffs) c = c * r2 + k;
+
+    IVec n = toInt(q) & 3;
+    IVec swap = (n & 1) != 0;
+    Vec sinBase = select(swap, c, s);
+    Vec cosBase = select(swap, s, c);
+    if (sinOut) *sinOut = select((n & 2) != 0, -sinBase, sinBase);
+    if (cosOut) *cosOut = select(((n + 1) & 2) != 0, -cosBase, cosBase);
+}
+
+// Дорожки вне диапазона точной редукции досчитываются скалярно
+template<typename F>
+BATCH_INLINE void fixLargeArguments(const Vec& x, Vec& y, F scalar) {
+    for (size_t k = 0; k < BatchLanes; ++k) {
+        if (std::fabs(x[k]) > TrigReductionLimit) y[k] = scalar(x[k]);
+    }
+}
+
+BATCH_INLINE Vec vsin(const Vec& x) {
+    Vec y;
+    vsincos(x, &y, nullptr);
+    fixLargeArguments(x, y, [](double v) { return std::sin(v); });
+    return y;
+}
+
+BATCH_INLINE Vec vcos(const Vec& x) {
+    Vec y;
+    vsincos(x, nullptr, &y);
+    fixLargeArguments(x, y, [](double v) { return std::cos(v); });
+    return y;
+}
+
+// Для pow векторное ядро не используется: exp(b ln a) теряет точность
+// и неверно для отрицательных оснований с целыми показателями
+BATCH_INLINE Vec vpow(const Vec& a, const Vec& b) {
+    Vec y;
+    for (size_t k = 0; k < BatchLanes; ++k) y[k] = std::pow(a[k], b[k]);
+    return y;
+}
+
+} // namespace
+
+void evaluateBatch(const CompiledExpression<double>& program,
+                   const double* const* columns, double* out, size_t count) {
+    const size_t vars = program.variables().size();
+    const std::vector<double>& constants = program.constants();
+
+    thread_local std::vector<Lane> registers;
+    if (registers.size() < program.registerCount()) {
+        registers.resize(program.registerCount());
+    }
+    Lane* r = registers.data();
+
+    // Константы не перезаписываются программой, их достаточно разложить один раз
+    for (size_t i = 0; i < constants.size(); ++i) {
+        r[vars + i].v = broadcast(constants[i]);
+    }
+
+    for (size_t base = 0; base < count; base += BatchLanes) {
+        const size_t n = std::min(BatchLanes, count - base);
+        for (size_t i = 0; i < vars; ++i) {
+            Vec v = broadcast(0.0);
+            std::memcpy(&v, columns[i] + base, n * sizeof(double));
+            r[i].v = v;
+        }
+
+        for (const Instruction& in : program.code()) {
+            Vec a = r[in.a].v;
+            switch (in.op) {
+                case OpCode::Neg: r[in.dst].v = -a; break;
+                case OpCode::Sin: r[in.dst].v = vsin(a); break;
+                case OpCode::Cos: r[in.dst].v = vcos(a); break;
+                case OpCode::Ln:  r[in.dst].v = vlog(a); break;
+                case OpCode::Exp: r[in.dst].v = vexp(a); break;
+                case OpCode::Add: r[in.dst].v = a + r[in.b].v; break;
+                case OpCode::Sub: r[in.dst].v = a - r[in.b].v; break;
+                case OpCode::Mul: r[in.dst].v = a * r[in.b].v; break;
+                case OpCode::Div: r[in.dst].v = a / r[in.b].v; break;
+                case OpCode::Pow: r[in.dst].v = vpow(a, r[in.b].v); break;
+            }
+        }
+
+        Vec result = r[program.resultRegister()].v;
+        std::memcpy(out + base, &result, n * sizeof(double));
+    }
+}
+
+void evaluateBatch(const CompiledExpression<double>& program,
+                   const double* const* columns, double* out, size_t count, ThreadPool& pool) {
+    // Пул режет диапазон на блоки по Grain, Grain кратен ширине вектора:
+    // неполным остаётся только последний вектор последнего блока
+    constexpr size_t Grain = 512 * BatchLanes;
+    const size_t vars = program.variables().size();
+    pool.parallelFor(count, Grain, [&](size_t begin, size_t end) {
+        std::vector<const double*> shifted(vars);
+        for (size_t i = 0; i < vars; ++i) {
+            shifted[i] = columns[i] + begin;
+        }
+        evaluateBatch(program, shifted.data(), out + begin, end - begin);
+    });
+}
@@ -0,0 +1,99 @@
+#include "../include/bulk_parser.hpp"
+#include "../include/dual.hpp"
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <utility>
+
+namespace {
+
+// Участок не короче MinChunk байт: на коротком входе не стоит будить пул
+constexpr size_t MinChunk = 64 * 1024;
+// Участков на поток: строки разной длины выравниваются перехватом работы
+constexpr size_t ChunksPerThread = 8;
+
+// Границы участков [begin, end), каждый начинается с начала строки
+std::vector<std::pair<size_t, size_t>> splitAtLines(std::string_view text, size_t chunkSize) {
+    std::vector<std::pair<size_t, size_t>> chunks;
+    size_t begin = 0;
+    while (begin < text.size()) {
+        size_t end = begin + chunkSize;
+        if (end >= text.size()) {
+            end = text.size();
+        } else {
+            size_t newline = text.find('\n', end);
+            end = newline == std::string_view::npos ? text.size() : newline + 1;
+        }
+        chunks.emplace_back(begin, end);
+        begin = end;
+    }
+    return chunks;
+}
+
+bool isBlank(std::string_view line) {
+    return line.find_first_not_of(" \t\r") == std::string_view::npos;
+}
+
+} // namespace
+
+template<typename T>
+std::vector<Expression<T>> parseLines(std::string_view text, ThreadPool& pool, const OperatorTable<T>& operators,
+                                      const ParseLimits& limits) {
+    struct Chunk {
+        std::vector<Expression<T>> expressions;
+        size_t errorOffset = std::string_view::npos;
+        std::string error;
+    };
+
+    const size_t chunkSize = std::max(MinChunk, text.size() / (pool.size() * ChunksPerThread) + 1);
+    const auto bounds = splitAtLines(text, chunkSize);
+    std::vector<Chunk> chunks(bounds.size());
+
+    pool.parallelFor(bounds.size(), 1, [&](size_t first, size_t last) {
+        for (size_t c = first; c < last; ++c) {
+            Chunk& chunk = chunks[c];
+            size_t pos = bounds[c].first;
+            while (pos < bounds[c].second) {
+                size_t newline = text.find('\n', pos);
+                size_t end = std::min(newline == std::string_view::npos ? text.size() : newline, bounds[c].second);
+                std::string_view line = text.substr(pos, end - pos);
+                if (!isBlank(line)) {
+                    try {
+                        chunk.expressions.push_back(parseExpression<T>(line, operators, limits));
+                    } catch (const ParseError& e) {
+                        // Позиция пересчитывается в буфер после разбора: строка и
+                        // столбец зависят от всего текста до ошибки
+                        chunk.errorOffset = pos + e.offset();
+                        chunk.error = e.message();
+                        break;
+                    }
+                }
+                pos = end + 1;
+            }
+        }
+    });
+
+    size_t total = 0;
+    for (const Chunk& chunk : chunks) {
+        if (chunk.errorOffset != std::string_view::npos) throw ParseError::at(text, chunk.errorOffset, chunk.error);
+        total += chunk.expressions.size();
+    }
+    std::vector<Expression<T>> result;
+    result.reserve(total);
+    for (Chunk& chunk : chunks) {
+        std::move(chunk.expressions.begin(), chunk.expressions.end(), std::back_inserter(result));
+    }
+    return result;
+}
+
+// Явные инстанцирования
+template std::vector<Expression<double>> parseLines(std::string_view, ThreadPool&, const OperatorTable<double>&,
+                                                    const ParseLimits&);
+template std::vector<Expression<std::complex<double>>> parseLines(std::string_view, ThreadPool&,
+                                                                  const OperatorTable<std::complex<double>>&,
+                                                                  const ParseLimits&);
+template std::vector<Expression<Dual<double>>> parseLines(std::string_view, ThreadPool&,
+                                                          const OperatorTable<Dual<double>>&, const ParseLimits&);
+template std::vector<Expression<HyperDual<double>>> parseLines(std::string_view, ThreadPool&,
+                                                               const OperatorTable<HyperDual<double>>&,
+                                                               const ParseLimits&);
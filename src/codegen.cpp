@@ -0,0 +1,128 @@
+#include "../include/codegen.hpp"
+#include "../include/compiler.hpp"
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// Литерал, который читается обратно в тот же double
+std::string literal(double value) {
+    if (std::isnan(value)) return "std::nan(\"\")";
+    if (std::isinf(value)) return value > 0 ? "HUGE_VAL" : "(-HUGE_VAL)";
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+    std::string text = buffer;
+    if (text.find_first_of(".e") == std::string::npos) text += ".0";
+    return value < 0 ? "(" + text + ")" : text;
+}
+
+// Параметры и локальные переменные называются _v0, _t0, ...: имена переменных
+// выражения могут быть ключевыми словами C++ или макросами <cmath> (for, NAN),
+// поэтому в код они попадают только в комментариях
+class Writer {
+public:
+    explicit Writer(const CompiledExpression<double>& program) : program_(program) {}
+
+    std::string reg(uint32_t r) const {
+        const size_t vars = program_.variables().size();
+        const size_t consts = program_.constants().size();
+        if (r < vars) return "_v" + std::to_string(r);
+        if (r < vars + consts) return literal(program_.constants()[r - vars]);
+        return "_t" + std::to_string(r - vars - consts);
+    }
+
+    // Тело: по одной константной локальной переменной на инструкцию
+    void body(std::ostringstream& os, const std::string& indent) const {
+        for (const Instruction& in : program_.code()) {
+            os << indent << "const double " << reg(in.dst) << " = " << value(in) << ";\n";
+        }
+    }
+
+private:
+    std::string value(const Instruction& in) const {
+        const std::string a = reg(in.a);
+        switch (in.op) {
+            case OpCode::Neg: return "-" + a;
+            case OpCode::Sin: return "std::sin(" + a + ")";
+            case OpCode::Cos: return "std::cos(" + a + ")";
+            case OpCode::Ln:  return "std::log(" + a + ")";
+            case OpCode::Exp: return "std::exp(" + a + ")";
+            default: break;
+        }
+        const std::string b = reg(in.b);
+        switch (in.op) {
+            case OpCode::Add: return a + " + " + b;
+            case OpCode::Sub: return a + " - " + b;
+            case OpCode::Mul: return a + " * " + b;
+            case OpCode::Div: return a + " / " + b;
+            default: break;
+        }
+        // Без -ffast-math компилятор не раскрывает pow(x, 2), поэтому квадрат — явно
+        const size_t vars = program_.variables().size();
+        if (in.b >= vars && in.b < vars + program_.constants().size()
+            && program_.constants()[in.b - vars] == 2.0) {
+            return a + " * " + a;
+        }
+        return "std::pow(" + a + ", " + b + ")";
+    }
+
+    const CompiledExpression<double>& program_;
+};
+
+} // namespace
+
+std::string generateCpp(const std::vector<Expression<double>>& outputs,
+                        const std::vector<std::string>& variables,
+                        const CodegenOptions& options) {
+    if (outputs.empty()) throw std::invalid_argument("generateCpp: no outputs");
+    CompiledExpression<double> program = compile(outputs, variables);
+    Writer writer(program);
+    const std::vector<std::string>& names = program.variables();
+    const std::vector<uint32_t>& results = program.resultRegisters();
+
+    std::ostringstream os;
+    os << "#include <cmath>\n#include <cstddef>\n\n";
+    for (size_t i = 0; i < names.size(); ++i) {
+        os << "// " << writer.reg(static_cast<uint32_t>(i)) << ": " << names[i] << "\n";
+    }
+    for (size_t k = 0; k < options.labels.size() && k < results.size(); ++k) {
+        os << "// out[" << k << "]: " << options.labels[k] << "\n";
+    }
+
+    os << "inline void " << options.name << "(";
+    for (size_t i = 0; i < names.size(); ++i) {
+        os << "double " << writer.reg(static_cast<uint32_t>(i)) << ", ";
+    }
+    os << "double* _out) {\n";
+    writer.body(os, "    ");
+    for (size_t k = 0; k < results.size(); ++k) {
+        os << "    _out[" << k << "] = " << writer.reg(results[k]) << ";\n";
+    }
+    os << "}\n";
+
+    if (options.kernel) {
+        // Столбцы не пересекаются, поэтому __restrict разрешает векторизацию
+        os << "\ninline void " << options.name << "_kernel(";
+        for (size_t i = 0; i < names.size(); ++i) {
+            os << "const double* __restrict " << writer.reg(static_cast<uint32_t>(i)) << ", ";
+        }
+        for (size_t k = 0; k < results.size(); ++k) {
+            os << "double* __restrict _out" << k << ", ";
+        }
+        os << "std::size_t _n) {\n";
+        os << "    for (std::size_t _i = 0; _i < _n; ++_i) {\n";
+        os << "        double _r[" << results.size() << "];\n";
+        os << "        " << options.name << "(";
+        for (size_t i = 0; i < names.size(); ++i) {
+            os << writer.reg(static_cast<uint32_t>(i)) << "[_i], ";
+        }
+        os << "_r);\n";
+        for (size_t k = 0; k < results.size(); ++k) {
+            os << "        _out" << k << "[_i] = _r[" << k << "];\n";
+        }
+        os << "    }\n}\n";
+    }
+    return os.str();
+}
@@ -0,0 +1,339 @@
+#include "../include/compiler.hpp"
+#include "../include/dual.hpp"
+#include "../include/stats.hpp"
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+// При генерации операнды помечаются видом регистра, номера окончательно
+// раскладываются по регистровому файлу после того, как известны все константы
+constexpr uint32_t VarTag   = 0u << 30;
+constexpr uint32_t ConstTag = 1u << 30;
+constexpr uint32_t TempTag  = 2u << 30;
+constexpr uint32_t TagMask  = 3u << 30;
+
+// Ключ нумерации значений: операция и регистры операндов
+struct ValueKey {
+    OpCode op;
+    uint32_t a;
+    uint32_t b;
+    bool operator==(const ValueKey& other) const { return op == other.op && a == other.a && b == other.b; }
+};
+
+struct ValueKeyHash {
+    size_t operator()(const ValueKey& key) const {
+        return (static_cast<size_t>(key.op) * 0x9E3779B97F4A7C15ull) ^ (static_cast<size_t>(key.a) << 32) ^ key.b;
+    }
+};
+
+template<typename T>
+struct Lowering {
+    // Слот переменной по номеру её символа
+    SymbolMap<uint32_t> slots;
+    std::vector<T> constants;
+    std::vector<Instruction> code;
+    uint32_t temps = 0;
+
+    // Уже обработанные узлы DAG и уже вычисленные значения (op, a, b):
+    // каждое общее подвыражение попадает в программу один раз
+    std::unordered_map<const void*, uint32_t> nodes;
+    std::unordered_map<ValueKey, uint32_t, ValueKeyHash> values;
+
+    // Обход в обратном порядке по явному стеку: операнды узла попадают
+    // в nodes раньше него, константы нумеруются слева направо
+    uint32_t emit(const Expression<T>& root) {
+        std::vector<std::pair<Expression<T>, bool>> stack = {{root, false}};
+        while (!stack.empty()) {
+            SYMDIFF_MAX(MaxStackDepth, stack.size());
+            auto [e, ready] = std::move(stack.back());
+            stack.pop_back();
+            if (nodes.count(e.id())) continue;
+            if (!ready && e.arity() > 0) {
+                stack.emplace_back(e, true);
+                for (size_t i = e.arity(); i-- > 0;) stack.emplace_back(e.operand(i), false);
+                continue;
+            }
+            nodes.emplace(e.id(), lower(e));
+        }
+        return nodes.at(root.id());
+    }
+
+    uint32_t lower(const Expression<T>& e) {
+        switch (e.kind()) {
+            case NodeKind::Constant:
+                constants.push_back(e.value());
+                return ConstTag | static_cast<uint32_t>(constants.size() - 1);
+            case NodeKind::Variable: {
+                const uint32_t* slot = slots.find(e.symbol());
+                if (!slot) throw std::runtime_error("Unknown variable: " + e.name());
+                return VarTag | *slot;
+            }
+            default:
+                break;
+        }
+
+        Instruction in{opcode(e.kind()), 0, nodes.at(e.operand(0).id()), 0};
+        if (e.arity() == 2) {
+            in.b = nodes.at(e.operand(1).id());
+        }
+        // Сложение и умножение коммутативны: x * y и y * x — одно значение
+        ValueKey key{in.op, in.a, in.b};
+        if ((in.op == OpCode::Add || in.op == OpCode::Mul) && key.a > key.b) {
+            std::swap(key.a, key.b);
+        }
+        auto [it, inserted] = values.emplace(key, TempTag | temps);
+        if (!inserted) return it->second;
+
+        in.dst = TempTag | temps++;
+        code.push_back(in);
+        return in.dst;
+    }
+
+    static OpCode opcode(NodeKind kind) {
+        switch (kind) {
+            case NodeKind::Neg: return OpCode::Neg;
+            case NodeKind::Sin: return OpCode::Sin;
+            case NodeKind::Cos: return OpCode::Cos;
+            case NodeKind::Ln:  return OpCode::Ln;
+            case NodeKind::Exp: return OpCode::Exp;
+            case NodeKind::Add: return OpCode::Add;
+            case NodeKind::Sub: return OpCode::Sub;
+            case NodeKind::Mul: return OpCode::Mul;
+            case NodeKind::Div: return OpCode::Div;
+            case NodeKind::Pow: return OpCode::Pow;
+            default:
+                throw std::runtime_error("Cannot compile node");
+        }
+    }
+};
+
+template<typename T>
+void collectVariables(const Expression<T>& root, std::set<std::string>& out) {
+    std::unordered_set<const void*> seen;
+    std::vector<Expression<T>> stack = {root};
+    while (!stack.empty()) {
+        Expression<T> e = std::move(stack.back());
+        stack.pop_back();
+        if (!seen.insert(e.id()).second) continue;
+        if (e.kind() == NodeKind::Variable) out.insert(e.name());
+        for (size_t i = 0; i < e.arity(); ++i) stack.push_back(e.operand(i));
+    }
+}
+
+} // namespace
+
+template<typename T>
+CompiledExpression<T> compile(const Expression<T>& expr, const std::vector<std::string>& variables) {
+    return compile(std::vector<Expression<T>>{expr}, variables);
+}
+
+template<typename T>
+CompiledExpression<T> compile(const std::vector<Expression<T>>& exprs, const std::vector<std::string>& variables) {
+    SYMDIFF_TIME(Compile);
+    if (exprs.empty()) {
+        throw std::invalid_argument("Nothing to compile");
+    }
+
+    CompiledExpression<T> program;
+    program.variables_ = variables;
+    if (program.variables_.empty()) {
+        std::set<std::string> found;
+        for (const Expression<T>& expr : exprs) {
+            collectVariables(expr, found);
+        }
+        program.variables_.assign(found.begin(), found.end());
+    }
+
+    Lowering<T> lowering;
+    for (size_t i = 0; i < program.variables_.size(); ++i) {
+        lowering.slots.set(Symbol(program.variables_[i]), static_cast<uint32_t>(i));
+    }
+    std::vector<uint32_t> results;
+    for (const Expression<T>& expr : exprs) {
+        results.push_back(lowering.emit(expr));
+    }
+
+    // Раскладка регистров: переменные, константы, временные
+    uint32_t constBase = static_cast<uint32_t>(program.variables_.size());
+    uint32_t tempBase = constBase + static_cast<uint32_t>(lowering.constants.size());
+    auto place = [&](uint32_t reg) {
+        uint32_t index = reg & ~TagMask;
+        switch (reg & TagMask) {
+            case ConstTag: return constBase + index;
+            case TempTag:  return tempBase + index;
+            default:       return index;
+        }
+    };
+    for (Instruction& in : lowering.code) {
+        in.dst = place(in.dst);
+        in.a = place(in.a);
+        in.b = place(in.b);
+    }
+
+    program.constants_ = std::move(lowering.constants);
+    program.code_ = std::move(lowering.code);
+    program.registers_ = tempBase + lowering.temps;
+    for (uint32_t result : results) {
+        program.results_.push_back(place(result));
+    }
+    return program;
+}
+
+template<typename T>
+T CompiledExpression<T>::eval(const T* slots) const {
+    // Регистровый файл выделяется один раз на поток и переиспользуется
+    thread_local std::vector<T> registers;
+    if (registers.size() < registers_) {
+        registers.resize(registers_);
+    }
+    forward(slots, registers.data());
+    return registers[results_.front()];
+}
+
+template<typename T>
+void CompiledExpression<T>::evalAll(const T* slots, T* out) const {
+    thread_local std::vector<T> registers;
+    if (registers.size() < registers_) {
+        registers.resize(registers_);
+    }
+    forward(slots, registers.data());
+    for (size_t k = 0; k < results_.size(); ++k) {
+        out[k] = registers[results_[k]];
+    }
+}
+
+template<typename T>
+void CompiledExpression<T>::forward(const T* slots, T* r) const {
+    // Неквалифицированные вызовы: для Dual и HyperDual функции находятся по ADL
+    using std::sin, std::cos, std::log, std::exp, std::pow;
+
+    std::copy(slots, slots + variables_.size(), r);
+    std::copy(constants_.begin(), constants_.end(), r + variables_.size());
+
+    for (const Instruction& in : code_) {
+        switch (in.op) {
+            case OpCode::Neg: r[in.dst] = -r[in.a]; break;
+            case OpCode::Sin: r[in.dst] = sin(r[in.a]); break;
+            case OpCode::Cos: r[in.dst] = cos(r[in.a]); break;
+            case OpCode::Ln:  r[in.dst] = log(r[in.a]); break;
+            case OpCode::Exp: r[in.dst] = exp(r[in.a]); break;
+            case OpCode::Add: r[in.dst] = r[in.a] + r[in.b]; break;
+            case OpCode::Sub: r[in.dst] = r[in.a] - r[in.b]; break;
+            case OpCode::Mul: r[in.dst] = r[in.a] * r[in.b]; break;
+            case OpCode::Div: r[in.dst] = r[in.a] / r[in.b]; break;
+            case OpCode::Pow: r[in.dst] = pow(r[in.a], r[in.b]); break;
+        }
+    }
+}
+
+template<typename T>
+T CompiledExpression<T>::gradient(const T* slots, T* grad) const {
+    thread_local std::vector<T> registers;
+    thread_local std::vector<T> adjoints;
+    if (registers.size() < registers_) {
+        registers.resize(registers_);
+        adjoints.resize(registers_);
+    }
+    T* r = registers.data();
+    T* d = adjoints.data();
+    forward(slots, r);
+
+    using std::sin, std::cos, std::log, std::pow;
+    // Каждый временный регистр пишется одной инструкцией, поэтому сопряжённые
+    // значения накапливаются проходом по программе в обратном порядке
+    std::fill(d, d + registers_, T(0));
+    d[results_.front()] = T(1);
+    for (auto it = code_.rbegin(); it != code_.rend(); ++it) {
+        const Instruction& in = *it;
+        const T bar = d[in.dst];
+        if (bar == T(0)) continue;
+        const T& a = r[in.a];
+        const T& b = r[in.b];
+        switch (in.op) {
+            case OpCode::Neg: d[in.a] -= bar; break;
+            case OpCode::Sin: d[in.a] += bar * cos(a); break;
+            case OpCode::Cos: d[in.a] -= bar * sin(a); break;
+            case OpCode::Ln:  d[in.a] += bar / a; break;
+            case OpCode::Exp: d[in.a] += bar * r[in.dst]; break;
+            case OpCode::Add: d[in.a] += bar; d[in.b] += bar; break;
+            case OpCode::Sub: d[in.a] += bar; d[in.b] -= bar; break;
+            case OpCode::Mul: d[in.a] += bar * b; d[in.b] += bar * a; break;
+            case OpCode::Div: d[in.a] += bar / b; d[in.b] -= bar * r[in.dst] / b; break;
+            case OpCode::Pow:
+                d[in.a] += bar * b * pow(a, b - T(1));
+                // Ветвь по показателю существует только при ненулевом основании
+                if (a != T(0)) d[in.b] += bar * r[in.dst] * log(a);
+                break;
+        }
+    }
+
+    std::copy(d, d + variables_.size(), grad);
+    return r[results_.front()];
+}
+
+template<typename T>
+std::map<std::string, T> Expression<T>::gradient(const std::map<std::string, T>& vars) const {
+    std::vector<std::string> names;
+    std::vector<T> slots;
+    for (const auto& [name, value] : vars) {
+        names.push_back(name);
+        slots.push_back(value);
+    }
+    CompiledExpression<T> program = compile(*this, names);
+    std::vector<T> grad(names.size());
+    program.gradient(slots.data(), grad.data());
+
+    std::map<std::string, T> result;
+    for (size_t i = 0; i < names.size(); ++i) {
+        result.emplace(names[i], grad[i]);
+    }
+    return result;
+}
+
+template<typename T>
+T CompiledExpression<T>::eval(const std::map<std::string, T>& vars) const {
+    std::vector<T> slots;
+    slots.reserve(variables_.size());
+    for (const std::string& name : variables_) {
+        auto it = vars.find(name);
+        if (it == vars.end()) {
+            throw std::runtime_error("Unknown variable: " + name);
+        }
+        slots.push_back(it->second);
+    }
+    return eval(slots.data());
+}
+
+template<typename T>
+size_t CompiledExpression<T>::slot(const std::string& variable) const {
+    auto it = std::find(variables_.begin(), variables_.end(), variable);
+    if (it == variables_.end()) {
+        throw std::out_of_range("No slot for variable: " + variable);
+    }
+    return static_cast<size_t>(it - variables_.begin());
+}
+
+// ===== Явные инстанцирования =====
+
+template class CompiledExpression<double>;
+template class CompiledExpression<std::complex<double>>;
+template class CompiledExpression<Dual<double>>;
+template class CompiledExpression<HyperDual<double>>;
+
+template std::map<std::string, double> Expression<double>::gradient(const std::map<std::string, double>&) const;
+template std::map<std::string, std::complex<double>> Expression<std::complex<double>>::gradient(const std::map<std::string, std::complex<double>>&) const;
+
+template CompiledExpression<double> compile(const Expression<double>&, const std::vector<std::string>&);
+template CompiledExpression<double> compile(const std::vector<Expression<double>>&, const std::vector<std::string>&);
+template CompiledExpression<std::complex<double>> compile(const Expression<std::complex<double>>&, const std::vector<std::string>&);
+template CompiledExpression<std::complex<double>> compile(const std::vector<Expression<std::complex<double>>>&, const std::vector<std::string>&);
+template CompiledExpression<Dual<double>> compile(const Expression<Dual<double>>&, const std::vector<std::string>&);
+template CompiledExpression<Dual<double>> compile(const std::vector<Expression<Dual<double>>>&, const std::vector<std::string>&);
+template CompiledExpression<HyperDual<double>> compile(const Expression<HyperDual<double>>&, const std::vector<std::string>&);
+template CompiledExpression<HyperDual<double>> compile(const std::vector<Expression<HyperDual<double>>>&, const std::vector<std::string>&);
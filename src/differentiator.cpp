@@ -1,26 +1,368 @@
 #include "../include/Expression.hpp"
+#include "../include/batch.hpp"
+#include "../include/bulk_parser.hpp"
+#include "../include/codegen.hpp"
+#include "../include/json.hpp"
+#include "../include/library.hpp"
+#include "../include/serialize.hpp"
+#include "../include/server.hpp"
+#include "../include/stats.hpp"
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <thread>
 #include <string>
+#include <string_view>
 #include <map>
+#include <sstream>
+#include <vector>
 #include <stdexcept>
 
 // Объявление парсера
 template<typename T>
-Expression<T> parseExpression(const std::string& input);
+Expression<T> parseExpression(std::string_view input);
 
 void print_usage() {
     std::cout << "Usage:\n";
     std::cout << "  --eval \"expression\" var1=val1 var2=val2 ...\n";
     std::cout << "  --diff \"expression\" --by var\n";
+    std::cout << "  --sweep \"expression\" --points N var1=from:to var2=from:to ...\n";
+    std::cout << "  --codegen \"expression\" [--by var1,var2] [--name fn] [--kernel]\n";
+    std::cout << "  --batch [file] [--by var] [var1=val1 ...]   one expression or JSON record per line\n";
+    std::cout << "  --serve socket_path   JSON-lines server on a Unix domain socket\n";
+    std::cout << "  --to-binary input.txt output.sdx   one expression per line to a binary graph\n";
+    std::cout << "  --to-text input.sdx   binary graph back to text, one expression per line\n";
+    std::cout << "  --build-library catalog.txt output.sdxl   lines of the form: name = expression\n";
+    std::cout << "  --library file.sdxl name [var1=val1 ...]   print or evaluate one library entry\n";
+    std::cout << "Options:\n";
+    std::cout << "  --threads N   worker threads for --sweep, --batch and --to-binary (default: all cores)\n";
+    std::cout << "  --stats       print hot-path counters and timers to stderr on exit\n";
+    std::cout << "                (build with -DSYMDIFF_STATS)\n";
+    std::cout << "  --max-depth N, --max-nodes N   reject deeper or larger expressions in --serve and --batch\n";
 }
 
+// Вычисление выражения в N точках: каждая переменная равномерно пробегает свой отрезок
+int run_sweep(const std::vector<std::string>& args, size_t threads) {
+    if (args.size() < 4 || args[2] != "--points") {
+        std::cerr << "Usage: --sweep \"expr\" --points N var=from:to ...\n";
+        return 1;
+    }
+
+    size_t points = std::stoul(args[3]);
+    std::vector<std::string> names;
+    std::vector<std::vector<double>> columns;
+    for (size_t i = 4; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        size_t eq = arg.find('=');
+        size_t colon = arg.find(':', eq);
+        if (eq == std::string::npos || colon == std::string::npos) {
+            std::cerr << "Invalid range format: " << arg << "\n";
+            return 1;
+        }
+        double from = std::stod(arg.substr(eq + 1, colon - eq - 1));
+        double to = std::stod(arg.substr(colon + 1));
+        std::vector<double> column(points);
+        for (size_t k = 0; k < points; ++k) {
+            column[k] = points > 1 ? from + (to - from) * k / (points - 1) : from;
+        }
+        names.push_back(arg.substr(0, eq));
+        columns.push_back(std::move(column));
+    }
+
+    CompiledExpression<double> program = compile(parseExpression<double>(args[1]), names);
+    std::vector<const double*> pointers;
+    for (const auto& column : columns) {
+        pointers.push_back(column.data());
+    }
+
+    std::vector<double> results(points);
+    ThreadPool pool(threads);
+    evaluateBatch(program, pointers.data(), results.data(), points, pool);
+
+    for (double value : results) {
+        std::cout << value << "\n";
+    }
+    return 0;
+}
+
+// Генерация C++: значение выражения и производные по перечисленным переменным
+int run_codegen(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        std::cerr << "Usage: --codegen \"expr\" [--by var1,var2] [--name fn] [--kernel]\n";
+        return 1;
+    }
+
+    CodegenOptions options;
+    std::vector<std::string> by;
+    for (size_t i = 2; i < args.size(); ++i) {
+        if (args[i] == "--kernel") {
+            options.kernel = true;
+        } else if (args[i] == "--name" && i + 1 < args.size()) {
+            options.name = args[++i];
+        } else if (args[i] == "--by" && i + 1 < args.size()) {
+            std::string list = args[++i];
+            size_t start = 0;
+            while (start <= list.size()) {
+                size_t comma = list.find(',', start);
+                if (comma == std::string::npos) comma = list.size();
+                if (comma > start) by.push_back(list.substr(start, comma - start));
+                start = comma + 1;
+            }
+        } else {
+            std::cerr << "Unknown codegen option: " << args[i] << "\n";
+            return 1;
+        }
+    }
+
+    Expression<double> expr = parseExpression<double>(args[1]);
+    std::vector<Expression<double>> outputs = {expr};
+    options.labels = {args[1]};
+    DerivativeCache<double> cache;
+    for (const std::string& variable : by) {
+        outputs.push_back(expr.differentiate(variable, cache));
+        options.labels.push_back("d/d" + variable);
+    }
+
+    std::cout << generateCpp(outputs, {}, options);
+    return 0;
+}
+
+// ===== Пакетный режим =====
+
+struct BatchOptions {
+    std::string variable;             // --by: дифференцировать по переменной
+    std::map<std::string, double> bindings;  // var=val: вычислить в точке
+};
+
+// Строка вида x=1.5
+bool parse_binding(const std::string& arg, std::map<std::string, double>& vars) {
+    size_t eq = arg.find('=');
+    if (eq == std::string::npos) return false;
+    vars[arg.substr(0, eq)] = std::stod(arg.substr(eq + 1));
+    return true;
+}
+
+// Простая строка: выражение обрабатывается общими опциями режима
+std::string process_line(const std::string& line, const BatchOptions& options, const Bindings<double>& bindings,
+                         const ParseLimits& limits) {
+    try {
+        Expression<double> expr = parseExpression<double>(line, limits);
+        if (!options.variable.empty()) {
+            expr = expr.differentiate(options.variable);
+        }
+        if (!options.bindings.empty()) {
+            std::ostringstream value;
+            value << expr.evaluate(bindings);
+            return value.str();
+        }
+        return expr.toString();
+    } catch (const std::exception& ex) {
+        return std::string("error: ") + ex.what();
+    }
+}
+
+// Чтение не более limit строк; пустой результат — конец входа
+std::vector<std::string> read_chunk(std::istream& in, size_t limit) {
+    std::vector<std::string> lines;
+    std::string line;
+    while (lines.size() < limit && std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        lines.push_back(std::move(line));
+    }
+    return lines;
+}
+
+// Вход читается блоками по ChunkLines строк: пока пул обрабатывает текущий
+// блок, отдельный поток читает следующий. В памяти не больше двух блоков,
+// результаты выводятся в порядке входа.
+int run_batch(const std::vector<std::string>& args, size_t threads, const ParseLimits& limits) {
+    constexpr size_t ChunkLines = 1024;
+
+    BatchOptions options;
+    std::string path;
+    for (size_t i = 1; i < args.size(); ++i) {
+        if (args[i] == "--by" && i + 1 < args.size()) {
+            options.variable = args[++i];
+        } else if (args[i].find('=') != std::string::npos) {
+            parse_binding(args[i], options.bindings);
+        } else if (path.empty()) {
+            path = args[i];
+        } else {
+            std::cerr << "Usage: --batch [file] [--by var] [var=val ...]\n";
+            return 1;
+        }
+    }
+
+    std::ifstream file;
+    if (!path.empty() && path != "-") {
+        file.open(path);
+        if (!file) {
+            std::cerr << "Cannot open " << path << "\n";
+            return 1;
+        }
+    }
+    std::istream& in = file.is_open() ? file : std::cin;
+    std::ios::sync_with_stdio(false);
+
+    const Bindings<double> bindings(options.bindings);
+    ThreadPool pool(threads);
+    std::vector<std::string> current = read_chunk(in, ChunkLines);
+    std::vector<std::string> next;
+    std::vector<std::string> results;
+    while (!current.empty()) {
+        std::thread reader([&] { next = read_chunk(in, ChunkLines); });
+
+        results.assign(current.size(), std::string());
+        pool.parallelFor(current.size(), 16, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const std::string& line = current[i];
+                size_t first = line.find_first_not_of(" \t");
+                if (first == std::string::npos) continue;
+                results[i] = line[first] == '{' ? processRecord(line, limits)
+                                                 : process_line(line, options, bindings, limits);
+            }
+        });
+        for (const std::string& result : results) {
+            std::cout << result << '\n';
+        }
+        std::cout.flush();
+
+        reader.join();
+        current.swap(next);
+    }
+    return 0;
+}
+
+// ===== Преобразование между текстом и двоичным форматом =====
+
+int run_to_binary(const std::vector<std::string>& args, size_t threads) {
+    if (args.size() != 3) {
+        std::cerr << "Usage: --to-binary input.txt output.sdx\n";
+        return 1;
+    }
+    std::ifstream file;
+    if (args[1] != "-") {
+        file.open(args[1], std::ios::binary | std::ios::ate);
+        if (!file) {
+            std::cerr << "Cannot open " << args[1] << "\n";
+            return 1;
+        }
+    }
+
+    // Весь вход читается в один буфер и разбирается на всех потоках прямо из него;
+    // размер файла известен заранее, стандартный ввод дочитывается до конца
+    std::string text;
+    if (file.is_open()) {
+        text.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(text.data(), static_cast<std::streamsize>(text.size()));
+        text.resize(static_cast<size_t>(file.gcount()));
+    } else {
+        text.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+    }
+    ThreadPool pool(threads);
+    saveExpressions(args[2], parseLines<double>(std::string_view(text), pool));
+    return 0;
+}
+
+int run_to_text(const std::vector<std::string>& args) {
+    if (args.size() != 2) {
+        std::cerr << "Usage: --to-text input.sdx\n";
+        return 1;
+    }
+    for (const Expression<double>& expr : loadExpressions<double>(args[1])) {
+        std::cout << expr.toString() << "\n";
+    }
+    return 0;
+}
+
+// ===== Библиотека именованных выражений =====
+
+int run_build_library(const std::vector<std::string>& args) {
+    if (args.size() != 3) {
+        std::cerr << "Usage: --build-library catalog.txt output.sdxl\n";
+        return 1;
+    }
+    std::ifstream in(args[1]);
+    if (!in) {
+        std::cerr << "Cannot open " << args[1] << "\n";
+        return 1;
+    }
+
+    std::vector<std::pair<std::string, Expression<double>>> entries;
+    std::string line;
+    for (size_t number = 1; std::getline(in, line); ++number) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        size_t eq = line.find('=');
+        size_t first = line.find_first_not_of(" \t");
+        size_t last = eq == std::string::npos ? eq : line.find_last_not_of(" \t", eq - 1);
+        if (eq == std::string::npos || first >= eq) {
+            std::cerr << "Line " << number << ": expected name = expression\n";
+            return 1;
+        }
+        entries.emplace_back(line.substr(first, last - first + 1), parseExpression<double>(line.substr(eq + 1)));
+    }
+    saveLibrary(args[2], std::move(entries));
+    return 0;
+}
+
+int run_library(const std::vector<std::string>& args) {
+    if (args.size() < 3) {
+        std::cerr << "Usage: --library file.sdxl name [var=val ...]\n";
+        return 1;
+    }
+    ExpressionLibrary<double> library(args[1]);
+    std::map<std::string, double> vars;
+    for (size_t i = 3; i < args.size(); ++i) {
+        if (!parse_binding(args[i], vars)) {
+            std::cerr << "Invalid variable format: " << args[i] << "\n";
+            return 1;
+        }
+    }
+    if (vars.empty()) {
+        std::cout << library.get(args[2]).toString() << "\n";
+    } else {
+        std::cout << library.compiled(args[2]).eval(vars) << "\n";
+    }
+    return 0;
+}
+
+// Статистика печатается при любом выходе из main
+struct StatsOnExit {
+    bool enabled = false;
+    ~StatsOnExit() {
+        if (enabled) std::cerr << Stats::report();
+    }
+};
+
 int main(int argc, char* argv[]) {
+    // Общие опции вынимаются из списка аргументов до разбора режима
+    std::vector<std::string> args;
+    size_t threads = 0;
+    ParseLimits limits;
+    StatsOnExit stats;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            threads = std::stoul(argv[++i]);
+        } else if (arg == "--max-depth" && i + 1 < argc) {
+            limits.maxDepth = std::stoul(argv[++i]);
+        } else if (arg == "--max-nodes" && i + 1 < argc) {
+            limits.maxNodes = std::stoul(argv[++i]);
+        } else if (arg == "--stats") {
+            stats.enabled = true;
+        } else {
+            args.push_back(arg);
+        }
+    }
+    argc = static_cast<int>(args.size()) + 1;
+
     if (argc < 2) {
         print_usage();
         return 1;
     }
 
-    std::string mode = argv[1];
+    std::string mode = args[0];
 
     try {
         if (mode == "--eval") {
@@ -29,12 +371,12 @@ int main(int argc, char* argv[]) {
                 return 1;
             }
 
-            std::string expr_str = argv[2];
+            std::string expr_str = args[1];
             std::map<std::string, double> vars;
 
             // Сначала разбираем переменные
             for (int i = 3; i < argc; ++i) {
-                std::string arg = argv[i];
+                std::string arg = args[i - 1];
                 size_t eq = arg.find('=');
                 if (eq == std::string::npos) {
                     std::cerr << "Invalid variable format: " << arg << "\n";
@@ -53,18 +395,48 @@ int main(int argc, char* argv[]) {
             std::cout << result << "\n";
         }
         else if (mode == "--diff") {
-            if (argc < 5 || std::string(argv[3]) != "--by") {
+            if (argc < 5 || args[2] != "--by") {
                 std::cerr << "Usage: --diff \"expr\" --by var\n";
                 return 1;
             }
 
-            std::string expr_str = argv[2];
-            std::string variable = argv[4];
+            std::string expr_str = args[1];
+            std::string variable = args[3];
 
             Expression<double> expr = parseExpression<double>(expr_str);
             Expression<double> derivative = expr.differentiate(variable);
             std::cout << derivative.toString() << "\n";
         }
+        else if (mode == "--sweep") {
+            return run_sweep(args, threads);
+        }
+        else if (mode == "--codegen") {
+            return run_codegen(args);
+        }
+        else if (mode == "--batch") {
+            return run_batch(args, threads, limits);
+        }
+        else if (mode == "--serve") {
+            if (argc < 3) {
+                std::cerr << "Usage: --serve socket_path\n";
+                return 1;
+            }
+            ExpressionServer server(limits);
+            std::cerr << "Listening on " << args[1] << "\n";
+            serveUnixSocket(args[1], server);
+        }
+        else if (mode == "--to-binary") {
+            return run_to_binary(args, threads);
+        }
+        else if (mode == "--to-text") {
+            return run_to_text(args);
+        }
+        else if (mode == "--build-library") {
+            return run_build_library(args);
+        }
+        else if (mode == "--library") {
+            return run_library(args);
+        }
         else {
             print_usage();
             return 1;
@@ -0,0 +1,172 @@
+#include "../include/jit.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#ifdef SYMDIFF_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef SYMDIFF_JIT
+namespace {
+
+// Кодировщик нужного подмножества x86-64. Регистровый файл программы живёт
+// в памяти: переменные по [rbx], константы по [r12], временные — в кадре [rsp].
+class Emitter {
+public:
+    enum Base { Rbx, R12, Rsp };
+
+    std::vector<uint8_t> code;
+
+    void bytes(std::initializer_list<uint8_t> list) { code.insert(code.end(), list); }
+
+    void imm32(uint32_t v) {
+        for (int i = 0; i < 4; ++i) code.push_back(static_cast<uint8_t>(v >> (8 * i)));
+    }
+
+    void imm64(uint64_t v) {
+        for (int i = 0; i < 8; ++i) code.push_back(static_cast<uint8_t>(v >> (8 * i)));
+    }
+
+    // movsd xmm, [base + disp32] (opcode 0x10) и movsd [base + disp32], xmm (0x11)
+    void movsd(uint8_t opcode, int xmm, Base base, uint32_t disp) {
+        code.push_back(0xF2);
+        if (base == R12) code.push_back(0x41);
+        bytes({0x0F, opcode});
+        uint8_t rm = base == Rbx ? 3 : 4;
+        code.push_back(static_cast<uint8_t>(0x80 | (xmm << 3) | rm));
+        if (base != Rbx) code.push_back(0x24);  // SIB без индекса
+        imm32(disp);
+    }
+
+    void load(int xmm, Base base, uint32_t disp) { movsd(0x10, xmm, base, disp); }
+    void store(int xmm, Base base, uint32_t disp) { movsd(0x11, xmm, base, disp); }
+
+    // addsd/subsd/mulsd/divsd xmm0, xmm1
+    void arith(uint8_t opcode) { bytes({0xF2, 0x0F, opcode, 0xC1}); }
+
+    // mov rax, imm64; call rax
+    void call(const void* target) {
+        bytes({0x48, 0xB8});
+        imm64(reinterpret_cast<uint64_t>(target));
+        bytes({0xFF, 0xD0});
+    }
+};
+
+} // namespace
+#endif
+
+JitFunction::JitFunction(const CompiledExpression<double>& program)
+    : program_(program) {
+#ifdef SYMDIFF_JIT
+    const uint32_t vars = static_cast<uint32_t>(program.variables().size());
+    const uint32_t consts = static_cast<uint32_t>(program.constants().size());
+    const uint32_t temps = program.registerCount() - vars - consts;
+
+    // Последняя константа — маска знака для Neg
+    constants_ = program.constants();
+    constants_.push_back(-0.0);
+    const uint32_t signMask = consts;
+
+    // После push rbx; push r12 стек выровнен на 8, кадр добирает до 16
+    uint32_t frame = temps * 8;
+    if (frame % 16 != 8) frame += 8;
+
+    Emitter e;
+    auto operand = [&](int xmm, uint32_t reg) {
+        if (reg < vars) e.load(xmm, Emitter::Rbx, reg * 8);
+        else if (reg < vars + consts) e.load(xmm, Emitter::R12, (reg - vars) * 8);
+        else e.load(xmm, Emitter::Rsp, (reg - vars - consts) * 8);
+    };
+
+    // Пролог
+    e.bytes({0x53});                  // push rbx
+    e.bytes({0x41, 0x54});            // push r12
+    e.bytes({0x48, 0x89, 0xFB});      // mov rbx, rdi
+    e.bytes({0x49, 0xBC});            // mov r12, imm64
+    e.imm64(reinterpret_cast<uint64_t>(constants_.data()));
+    e.bytes({0x48, 0x81, 0xEC});      // sub rsp, imm32
+    e.imm32(frame);
+
+    using Unary = double (*)(double);
+    using Binary = double (*)(double, double);
+    for (const Instruction& in : program.code()) {
+        operand(0, in.a);
+        switch (in.op) {
+            case OpCode::Neg:
+                e.load(1, Emitter::R12, signMask * 8);
+                e.bytes({0x66, 0x0F, 0x57, 0xC1});  // xorpd xmm0, xmm1
+                break;
+            case OpCode::Sin: e.call(reinterpret_cast<const void*>(static_cast<Unary>(std::sin))); break;
+            case OpCode::Cos: e.call(reinterpret_cast<const void*>(static_cast<Unary>(std::cos))); break;
+            case OpCode::Ln:  e.call(reinterpret_cast<const void*>(static_cast<Unary>(std::log))); break;
+            case OpCode::Exp: e.call(reinterpret_cast<const void*>(static_cast<Unary>(std::exp))); break;
+            case OpCode::Pow:
+                operand(1, in.b);
+                e.call(reinterpret_cast<const void*>(static_cast<Binary>(std::pow)));
+                break;
+            default:
+                operand(1, in.b);
+                e.arith(in.op == OpCode::Add ? 0x58 : in.op == OpCode::Sub ? 0x5C : in.op == OpCode::Mul ? 0x59 : 0x5E);
+                break;
+        }
+        e.store(0, Emitter::Rsp, (in.dst - vars - consts) * 8);
+    }
+
+    // Эпилог: результат в xmm0
+    operand(0, program.resultRegister());
+    e.bytes({0x48, 0x81, 0xC4});      // add rsp, imm32
+    e.imm32(frame);
+    e.bytes({0x41, 0x5C});            // pop r12
+    e.bytes({0x5B});                  // pop rbx
+    e.bytes({0xC3});                  // ret
+
+    // Страница сначала заполняется, затем становится исполняемой (W^X)
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t size = (e.code.size() + page - 1) / page * page;
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) return;
+    std::memcpy(memory, e.code.data(), e.code.size());
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return;
+    }
+    memory_ = memory;
+    size_ = size;
+    function_ = reinterpret_cast<Fn>(memory);
+#endif
+}
+
+JitFunction::~JitFunction() {
+    release();
+}
+
+JitFunction::JitFunction(JitFunction&& other) noexcept
+    : program_(std::move(other.program_)),
+      constants_(std::move(other.constants_)),
+      memory_(std::exchange(other.memory_, nullptr)),
+      size_(std::exchange(other.size_, 0)),
+      function_(std::exchange(other.function_, nullptr)) {}
+
+JitFunction& JitFunction::operator=(JitFunction&& other) noexcept {
+    if (this != &other) {
+        release();
+        program_ = std::move(other.program_);
+        constants_ = std::move(other.constants_);
+        memory_ = std::exchange(other.memory_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        function_ = std::exchange(other.function_, nullptr);
+    }
+    return *this;
+}
+
+void JitFunction::release() {
+#ifdef SYMDIFF_JIT
+    if (memory_) munmap(memory_, size_);
+#endif
+    memory_ = nullptr;
+    size_ = 0;
+    function_ = nullptr;
+}
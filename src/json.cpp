@@ -0,0 +1,220 @@
+#include "../include/json.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+class JsonParser {
+public:
+    JsonParser(std::string_view text, size_t maxDepth) : text_(text), maxDepth_(maxDepth) {}
+
+    // Вложенные массивы и объекты разбираются по явному стеку незаконченных
+    // контейнеров: глубина входа не расходует стек потока
+    JsonValue parseDocument() {
+        std::vector<Frame> stack;
+        while (true) {
+            JsonValue value;
+            if (openValue(value, stack)) continue;
+
+            // Значение готово: оно добавляется в контейнер на вершине стека,
+            // закрытые контейнеры становятся значениями своих родителей
+            while (!stack.empty()) {
+                Frame& top = stack.back();
+                const bool object = top.value.type == JsonValue::Type::Object;
+                if (object) {
+                    top.value.object.emplace_back(std::move(top.key), std::move(value));
+                } else {
+                    top.value.array.push_back(std::move(value));
+                }
+                if (consume(',')) {
+                    if (object) readKey(top);
+                    break;
+                }
+                expect(object ? '}' : ']');
+                value = std::move(top.value);
+                stack.pop_back();
+            }
+            if (stack.empty()) {
+                skipWhitespace();
+                if (pos_ != text_.size()) fail("Unexpected characters after JSON value");
+                return value;
+            }
+        }
+    }
+
+private:
+    struct Frame {
+        JsonValue value;
+        std::string key;   // ключ следующего значения объекта
+    };
+
+    std::string_view text_;
+    size_t maxDepth_;
+    size_t pos_ = 0;
+
+    [[noreturn]] void fail(const std::string& message) const {
+        throw std::runtime_error(message + " at position " + std::to_string(pos_));
+    }
+
+    void skipWhitespace() {
+        while (pos_ < text_.size()
+               && (text_[pos_] == ' ' || text_[pos_] == '\t' || text_[pos_] == '\n' || text_[pos_] == '\r')) {
+            ++pos_;
+        }
+    }
+
+    bool consume(char c) {
+        skipWhitespace();
+        if (pos_ < text_.size() && text_[pos_] == c) {
+            ++pos_;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        if (!consume(c)) fail(std::string("Expected '") + c + "'");
+    }
+
+    bool consumeWord(std::string_view word) {
+        if (text_.substr(pos_, word.size()) != word) return false;
+        pos_ += word.size();
+        return true;
+    }
+
+    void readKey(Frame& frame) {
+        skipWhitespace();
+        frame.key = parseString();
+        expect(':');
+    }
+
+    // Читает начало значения. Непустой массив или объект кладётся на стек
+    // (возвращается true), остальное читается целиком в value
+    bool openValue(JsonValue& value, std::vector<Frame>& stack) {
+        skipWhitespace();
+        if (pos_ == text_.size()) fail("Unexpected end of JSON");
+
+        const char c = text_[pos_];
+        if (c == '{' || c == '[') {
+            if (stack.size() >= maxDepth_) {
+                fail("JSON nesting exceeds the limit of " + std::to_string(maxDepth_));
+            }
+            ++pos_;
+            const bool object = c == '{';
+            value.type = object ? JsonValue::Type::Object : JsonValue::Type::Array;
+            if (consume(object ? '}' : ']')) return false;
+            stack.push_back({std::move(value), {}});
+            if (object) readKey(stack.back());
+            return true;
+        }
+        if (c == '"') {
+            value.type = JsonValue::Type::String;
+            value.string = parseString();
+        } else if (consumeWord("true")) {
+            value.type = JsonValue::Type::Bool;
+            value.boolean = true;
+        } else if (consumeWord("false")) {
+            value.type = JsonValue::Type::Bool;
+        } else if (consumeWord("null")) {
+            value.type = JsonValue::Type::Null;
+        } else {
+            value.type = JsonValue::Type::Number;
+            const char* begin = text_.data() + pos_;
+            auto [end, error] = std::from_chars(begin, text_.data() + text_.size(), value.number);
+            if (error != std::errc()) fail("Invalid JSON value");
+            pos_ += static_cast<size_t>(end - begin);
+        }
+        return false;
+    }
+
+    std::string parseString() {
+        if (pos_ >= text_.size() || text_[pos_] != '"') fail("Expected string");
+        ++pos_;
+        std::string out;
+        while (pos_ < text_.size() && text_[pos_] != '"') {
+            char c = text_[pos_++];
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (pos_ == text_.size()) break;
+            char e = text_[pos_++];
+            switch (e) {
+                case 'n': out += '\n'; break;
+                case 't': out += '\t'; break;
+                case 'r': out += '\r'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'u': {
+                    // Только базовая плоскость; суррогатные пары не склеиваются
+                    unsigned code = 0;
+                    auto [end, error] = std::from_chars(text_.data() + pos_, text_.data() + std::min(text_.size(), pos_ + 4), code, 16);
+                    if (error != std::errc() || end != text_.data() + pos_ + 4) fail("Invalid \\u escape");
+                    pos_ += 4;
+                    if (code < 0x80) {
+                        out += static_cast<char>(code);
+                    } else if (code < 0x800) {
+                        out += static_cast<char>(0xC0 | (code >> 6));
+                        out += static_cast<char>(0x80 | (code & 0x3F));
+                    } else {
+                        out += static_cast<char>(0xE0 | (code >> 12));
+                        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                        out += static_cast<char>(0x80 | (code & 0x3F));
+                    }
+                    break;
+                }
+                default: out += e; break;  // \" \\ \/
+            }
+        }
+        if (pos_ == text_.size()) fail("Unterminated string");
+        ++pos_;
+        return out;
+    }
+};
+
+} // namespace
+
+const JsonValue* JsonValue::find(std::string_view key) const {
+    for (const auto& [name, value] : object) {
+        if (name == key) return &value;
+    }
+    return nullptr;
+}
+
+JsonValue parseJson(std::string_view text, size_t maxDepth) {
+    return JsonParser(text, maxDepth).parseDocument();
+}
+
+std::string jsonQuote(std::string_view text) {
+    std::string out = "\"";
+    for (char c : text) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            case '\r': out += "\\r"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buffer[8];
+                    std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    out += buffer;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+    return out;
+}
+
+std::string jsonNumber(double value) {
+    if (!std::isfinite(value)) return "null";
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+    return buffer;
+}
@@ -0,0 +1,210 @@
+#include "../include/library.hpp"
+#include "../include/dual.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SYMDIFF_MMAP 1
+#endif
+
+namespace {
+
+constexpr char Magic[4] = {'S', 'D', 'X', 'L'};
+constexpr uint16_t Version = 1;
+
+uint64_t align8(uint64_t size) { return (size + 7) & ~uint64_t(7); }
+
+uint64_t namesOffset(uint32_t entries) {
+    return sizeof(LibraryHeader) + (uint64_t(entries) + 1) * sizeof(uint32_t);
+}
+
+} // namespace
+
+template<typename T>
+ExpressionLibrary<T>::ExpressionLibrary(const std::string& path) {
+#ifdef SYMDIFF_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot open " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    // MAP_SHARED: страницы из кэша ОС, без копии на процесс
+    void* data = size_ > 0 ? mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED) throw std::runtime_error("Cannot map " + path);
+    data_ = static_cast<const char*>(data);
+    mapped_ = true;
+#else
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) throw std::runtime_error("Cannot open " + path);
+    size_ = static_cast<size_t>(in.tellg());
+    buffer_.resize((size_ + 7) / 8);
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(buffer_.data()), static_cast<std::streamsize>(size_));
+    data_ = reinterpret_cast<const char*>(buffer_.data());
+#endif
+
+    try {
+        if (size_ < sizeof(LibraryHeader) || std::memcmp(data_, Magic, sizeof(Magic)) != 0) {
+            throw std::runtime_error("Not an expression library: " + path);
+        }
+        header_ = reinterpret_cast<const LibraryHeader*>(data_);
+        if (header_->version != Version) {
+            throw std::runtime_error("Unsupported expression library version " + std::to_string(header_->version));
+        }
+        uint64_t names = namesOffset(header_->entries);
+        // Проверки без сложения: поля из файла могут быть любыми, и сумма
+        // переполнилась бы, пропустив чтение за границей файла
+        const uint64_t graphOffset = header_->graphOffset;
+        if (graphOffset > size_ || header_->graphSize != size_ - graphOffset || graphOffset % 8 != 0
+            || names > graphOffset || header_->nameBytes > graphOffset - names) {
+            throw std::runtime_error("Corrupt expression library: " + path);
+        }
+        nameOffsets_ = reinterpret_cast<const uint32_t*>(data_ + sizeof(LibraryHeader));
+        names_ = data_ + names;
+        if (nameOffsets_[0] != 0 || nameOffsets_[header_->entries] != header_->nameBytes) {
+            throw std::runtime_error("Corrupt expression library: " + path);
+        }
+        for (uint32_t i = 0; i < header_->entries; ++i) {
+            if (nameOffsets_[i] > nameOffsets_[i + 1]) throw std::runtime_error("Corrupt expression library: " + path);
+        }
+        graph_.emplace(std::string_view(data_ + header_->graphOffset, header_->graphSize));
+        if (graph_->rootCount() != header_->entries) {
+            throw std::runtime_error("Corrupt expression library: " + path);
+        }
+    } catch (...) {
+#ifdef SYMDIFF_MMAP
+        munmap(const_cast<char*>(data_), size_);
+#endif
+        throw;
+    }
+}
+
+template<typename T>
+ExpressionLibrary<T>::~ExpressionLibrary() {
+#ifdef SYMDIFF_MMAP
+    if (mapped_) munmap(const_cast<char*>(data_), size_);
+#endif
+}
+
+template<typename T>
+size_t ExpressionLibrary<T>::find(std::string_view name) const {
+    size_t lo = 0, hi = size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (this->name(mid) < name) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < size() && this->name(lo) == name ? lo : npos;
+}
+
+template<typename T>
+size_t ExpressionLibrary<T>::indexOf(std::string_view name) const {
+    size_t index = find(name);
+    if (index == npos) throw std::out_of_range("No expression named " + std::string(name));
+    return index;
+}
+
+template<typename T>
+Expression<T> ExpressionLibrary<T>::get(size_t index) const {
+    if (index >= size()) throw std::out_of_range("Expression index out of range");
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = expressions_.find(index);
+        if (it != expressions_.end()) return it->second;
+    }
+    // Построение вне блокировки: узлы общие через таблицу узлов,
+    // поэтому гонка двух потоков даёт один и тот же результат
+    Expression<T> expr = graph_->expression(index);
+    std::lock_guard<std::mutex> lock(mutex_);
+    return expressions_.emplace(index, expr).first->second;
+}
+
+template<typename T>
+Expression<T> ExpressionLibrary<T>::get(std::string_view name) const {
+    return get(indexOf(name));
+}
+
+template<typename T>
+const CompiledExpression<T>& ExpressionLibrary<T>::compiled(size_t index) const {
+    Expression<T> expr = get(index);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = programs_.find(index);
+        if (it != programs_.end()) return it->second;
+    }
+    CompiledExpression<T> program = compile(expr);
+    std::lock_guard<std::mutex> lock(mutex_);
+    return programs_.emplace(index, std::move(program)).first->second;
+}
+
+template<typename T>
+const CompiledExpression<T>& ExpressionLibrary<T>::compiled(std::string_view name) const {
+    return compiled(indexOf(name));
+}
+
+template<typename T>
+size_t ExpressionLibrary<T>::materialized() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return expressions_.size();
+}
+
+template<typename T>
+void saveLibrary(const std::string& path, std::vector<std::pair<std::string, Expression<T>>> entries) {
+    std::sort(entries.begin(), entries.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (size_t i = 1; i < entries.size(); ++i) {
+        if (entries[i].first == entries[i - 1].first) {
+            throw std::runtime_error("Duplicate expression name: " + entries[i].first);
+        }
+    }
+
+    std::vector<uint32_t> nameOffsets = {0};
+    std::string names;
+    std::vector<Expression<T>> roots;
+    roots.reserve(entries.size());
+    for (const auto& [name, expr] : entries) {
+        names += name;
+        nameOffsets.push_back(static_cast<uint32_t>(names.size()));
+        roots.push_back(expr);
+    }
+    std::string graph = serializeExpressions(roots);
+
+    LibraryHeader header{};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.entries = static_cast<uint32_t>(entries.size());
+    header.nameBytes = static_cast<uint32_t>(names.size());
+    header.graphOffset = align8(namesOffset(header.entries) + names.size());
+    header.graphSize = graph.size();
+
+    std::string out(header.graphOffset, '\0');
+    std::memcpy(&out[0], &header, sizeof(header));
+    std::memcpy(&out[sizeof(header)], nameOffsets.data(), nameOffsets.size() * sizeof(uint32_t));
+    if (!names.empty()) std::memcpy(&out[namesOffset(header.entries)], names.data(), names.size());
+    out += graph;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(out.data(), static_cast<std::streamsize>(out.size()));
+    if (!file) throw std::runtime_error("Cannot write " + path);
+}
+
+// Явные инстанцирования
+template class ExpressionLibrary<double>;
+template class ExpressionLibrary<std::complex<double>>;
+template class ExpressionLibrary<Dual<double>>;
+template class ExpressionLibrary<HyperDual<double>>;
+
+template void saveLibrary(const std::string&, std::vector<std::pair<std::string, Expression<double>>>);
+template void saveLibrary(const std::string&, std::vector<std::pair<std::string, Expression<std::complex<double>>>>);
+template void saveLibrary(const std::string&, std::vector<std::pair<std::string, Expression<Dual<double>>>>);
+template void saveLibrary(const std::string&, std::vector<std::pair<std::string, Expression<HyperDual<double>>>>);
@@ -1,186 +1,266 @@
 #include "../include/Expression.hpp"
-#include "../include/parser.hpp"
+#include "../include/dual.hpp"
+#include "../include/stats.hpp"
 #include <cmath>
-#include <sstream>
 #include <stdexcept>
-#include <regex>
+#include <unordered_map>
+#include <vector>
 
 // ===== Реализация функций =====
 
 template<typename T>
 Expression<T> Expression<T>::sin(const Expression& expr) {
-    return Expression("sin(" + expr.toString() + ")");
+    return unary(NodeKind::Sin, expr);
 }
 
 template<typename T>
 Expression<T> Expression<T>::cos(const Expression& expr) {
-    return Expression("cos(" + expr.toString() + ")");
+    return unary(NodeKind::Cos, expr);
 }
 
 template<typename T>
 Expression<T> Expression<T>::ln(const Expression& expr) {
-    return Expression("ln(" + expr.toString() + ")");
+    return unary(NodeKind::Ln, expr);
 }
 
 template<typename T>
 Expression<T> Expression<T>::exp(const Expression& expr) {
-    return Expression("exp(" + expr.toString() + ")");
+    return unary(NodeKind::Exp, expr);
 }
 
-// ===== Подстановка переменной =====
 
+// ===== Вычисление обходом дерева =====
+
+// Обход в обратном порядке по явному стеку; значения операндов лежат на стеке значений
 template<typename T>
-Expression<T> Expression<T>::substitute(const std::string& var, const T& value) const {
-    std::ostringstream oss;
-    if constexpr (std::is_same_v<T, std::complex<double>>) {
-        oss << "(" << value.real() << "+" << value.imag() << "i)";
-    } else {
-        oss << value;
-    }
+T Expression<T>::evaluate(const Impl* root, const Bindings<T>& vars) {
+    // Неквалифицированные вызовы: для Dual и HyperDual функции находятся по ADL
+    using std::sin, std::cos, std::log, std::exp, std::pow;
+
+    std::vector<std::pair<const Impl*, bool>> stack = {{root, false}};
+    std::vector<T> values;
+    while (!stack.empty()) {
+        SYMDIFF_MAX(MaxStackDepth, stack.size());
+        auto [node, ready] = stack.back();
+        stack.pop_back();
+
+        if (!ready) {
+            switch (node->kind) {
+                case NodeKind::Constant:
+                    values.push_back(node->value);
+                    continue;
+                case NodeKind::Variable: {
+                    const T* value = vars.find(node->symbol);
+                    if (!value) {
+                        throw std::runtime_error("Unknown variable: " + node->symbol.name());
+                    }
+                    values.push_back(*value);
+                    continue;
+                }
+                default:
+                    stack.push_back({node, true});
+                    if (node->rhs) stack.push_back({node->rhs.get(), false});
+                    stack.push_back({node->lhs.get(), false});
+                    continue;
+            }
+        }
 
-    std::string result = pImpl->expr;
+        T& top = values.back();
+        switch (node->kind) {
+            case NodeKind::Neg: top = -top; continue;
+            case NodeKind::Sin: top = sin(top); continue;
+            case NodeKind::Cos: top = cos(top); continue;
+            case NodeKind::Ln:  top = log(top); continue;
+            case NodeKind::Exp: top = exp(top); continue;
+            default: break;
+        }
 
-    // Заменяем только полные вхождения переменной
-    std::regex r("\\b" + var + "\\b");
-    result = std::regex_replace(result, r, oss.str());
+        T rhs = values.back();
+        values.pop_back();
+        T& lhs = values.back();
+        switch (node->kind) {
+            case NodeKind::Add: lhs = lhs + rhs; break;
+            case NodeKind::Sub: lhs = lhs - rhs; break;
+            case NodeKind::Mul: lhs = lhs * rhs; break;
+            case NodeKind::Div: lhs = lhs / rhs; break;
+            case NodeKind::Pow: lhs = pow(lhs, rhs); break;
+            default:
+                throw std::runtime_error("Cannot evaluate expression: unknown node");
+        }
+    }
+    return values.back();
+}
 
-    return Expression<T>(result);
+template<typename T>
+T Expression<T>::evaluate(const std::map<std::string, T>& vars) const {
+    SYMDIFF_TIME(Evaluate);
+    return evaluate(pImpl.get(), Bindings<T>(vars));
 }
 
+template<typename T>
+T Expression<T>::evaluate(const Bindings<T>& vars) const {
+    SYMDIFF_TIME(Evaluate);
+    return evaluate(pImpl.get(), vars);
+}
 
 
-// ===== Простейшее вычисление (для double) =====
+// ===== Символьная производная =====
 
-template<>
-double Expression<double>::evaluate(const std::map<std::string, double>& vars) const {
-    // Подставляем переменные
-    Expression<double> substituted = substitute_all(vars);
-    std::string expr_str = substituted.toString();
+namespace {
 
-    // Если выражение не изменилось, то мы уже вычислили его
-    if (expr_str == pImpl->expr) {
-        try {
-            return std::stod(expr_str);  // Преобразуем к числу
-        } catch (...) {
-            throw std::runtime_error("Cannot evaluate expression: " + expr_str);
+// Зависит ли выражение от переменной. Ответ запоминается в memo для каждого
+// просмотренного узла, поэтому в пределах одного derivative вложенные
+// степени не обходят одни и те же показатели заново
+template<typename T>
+bool dependsOn(const Expression<T>& e, Symbol var, std::unordered_map<const void*, bool>& memo) {
+    // Обход в обратном порядке: ответ узла записывается после ответов операндов
+    std::vector<std::pair<Expression<T>, bool>> stack = {{e, false}};
+    while (!stack.empty()) {
+        auto [node, ready] = std::move(stack.back());
+        stack.pop_back();
+        if (memo.count(node.id())) continue;
+        if (node.arity() == 0) {
+            memo.emplace(node.id(), node.kind() == NodeKind::Variable && node.symbol() == var);
+            continue;
         }
+        if (!ready) {
+            stack.emplace_back(node, true);
+            for (size_t i = 0; i < node.arity(); ++i) stack.emplace_back(node.operand(i), false);
+            continue;
+        }
+        bool depends = false;
+        for (size_t i = 0; i < node.arity(); ++i) depends = depends || memo.at(node.operand(i).id());
+        memo.emplace(node.id(), depends);
     }
-
-    // Пробуем вычислить как математическую функцию
-    if (expr_str.find("sin(") == 0) {
-        double arg = parseExpression<double>(expr_str.substr(4, expr_str.size() - 5)).evaluate(vars);
-        return std::sin(arg);
-    }
-    if (expr_str.find("cos(") == 0) {
-        double arg = parseExpression<double>(expr_str.substr(4, expr_str.size() - 5)).evaluate(vars);
-        return std::cos(arg);
-    }
-    if (expr_str.find("ln(") == 0) {
-        double arg = parseExpression<double>(expr_str.substr(3, expr_str.size() - 4)).evaluate(vars);
-        return std::log(arg);
-    }
-    if (expr_str.find("exp(") == 0) {
-        double arg = parseExpression<double>(expr_str.substr(4, expr_str.size() - 5)).evaluate(vars);
-        return std::exp(arg);
-    }
-
-    // Попробуем распарсить арифметические выражения
-    try {
-        // Распарсим выражение как число
-        return std::stod(expr_str);
-    } catch (...) {}
-
-    // Пробуем парсить сложные выражения
-    Expression<double> parsed = parseExpression<double>(expr_str);
-    return parsed.evaluate(vars);  // Рекурсивный вызов
+    return memo.at(e.id());
 }
 
+} // namespace
 
+template<typename T>
+Expression<T> Expression<T>::differentiate(const std::string& var, bool simplifyResult) const {
+    return differentiate(Symbol(var), simplifyResult);
+}
 
-// ===== Символьная производная (double) =====
+template<typename T>
+Expression<T> Expression<T>::differentiate(Symbol var, bool simplifyResult) const {
+    DerivativeCache<T> cache;
+    return differentiate(var, cache, simplifyResult);
+}
 
 template<typename T>
-Expression<T> Expression<T>::differentiate(const std::string& var) const {
-    const std::string& e = pImpl->expr;
-
-    // Базовые случаи
-    if (e == var) return Expression(1.0);
-    try {
-        std::stod(e);
-        return Expression(0.0);
-    } catch (...) {}
-
-    // Сумма
-    size_t plus = e.find(" + ");
-    if (plus != std::string::npos) {
-        Expression<T> left(e.substr(0, plus));
-        Expression<T> right(e.substr(plus + 3));
-        return left.differentiate(var) + right.differentiate(var);
-    }
+Expression<T> Expression<T>::differentiate(const std::string& var, DerivativeCache<T>& cache,
+                                           bool simplifyResult) const {
+    return differentiate(Symbol(var), cache, simplifyResult);
+}
 
-    // Произведение
-    size_t mul = e.find(" * ");
-    if (mul != std::string::npos) {
-        Expression<T> u(e.substr(0, mul));
-        Expression<T> v(e.substr(mul + 3));
-        return u.differentiate(var) * v + u * v.differentiate(var);
-    }
+template<typename T>
+Expression<T> Expression<T>::differentiate(Symbol var, DerivativeCache<T>& cache, bool simplifyResult) const {
+    SYMDIFF_TIME(Differentiate);
+    Expression<T> result = derivative(var, cache);
+    return simplifyResult ? result.simplify() : result;
+}
 
-    // sin(...)
-    if (e.rfind("sin(", 0) == 0 && e.back() == ')') {
-        std::string inner = e.substr(4, e.size() - 5);
-        Expression<T> f(inner);
-        return Expression<T>::cos(f) * f.differentiate(var);
-    }
+// Производные узлов считаются в обратном порядке по явному стеку и кладутся
+// в кэш; правило узла применяется, когда производные нужных операндов уже там.
+// Промах — созданная запись кэша, попадание — посещение узла, производная
+// которого уже в кэше
+template<typename T>
+Expression<T> Expression<T>::derivative(Symbol var, DerivativeCache<T>& cache) const {
+    using Key = typename DerivativeCache<T>::Key;
+    auto lookup = [&](const Expression& e) -> const Expression& {
+        return cache.entries_.find(Key{e.id(), var.id()})->second.second;
+    };
+
+    struct Frame {
+        Expression node;
+        bool expanded;
+        bool needRhs;
+    };
+    DependencyMemo depends;
+    std::vector<Frame> stack = {{*this, false, false}};
+    while (!stack.empty()) {
+        SYMDIFF_MAX(MaxStackDepth, stack.size());
+        Frame frame = std::move(stack.back());
+        stack.pop_back();
+        const Expression& e = frame.node;
+        Key key{e.id(), var.id()};
+
+        if (!frame.expanded) {
+            if (cache.entries_.count(key)) {
+                ++cache.hits_;
+                SYMDIFF_COUNT(DerivativeCacheHits);
+                continue;
+            }
+            if (e.arity() > 0) {
+                // Производная показателя u^c не нужна: c от переменной не зависит
+                bool needRhs = e.arity() == 2 && !(e.kind() == NodeKind::Pow && !dependsOn(e.operand(1), var, depends));
+                stack.push_back({e, true, needRhs});
+                if (needRhs) stack.push_back({e.operand(1), false, false});
+                stack.push_back({e.operand(0), false, false});
+                continue;
+            }
+        } else if (cache.entries_.count(key)) {
+            // Узел встретился дважды, пока считались его операнды
+            ++cache.hits_;
+            SYMDIFF_COUNT(DerivativeCacheHits);
+            continue;
+        }
 
-    // cos(...)
-    if (e.rfind("cos(", 0) == 0 && e.back() == ')') {
-        std::string inner = e.substr(4, e.size() - 5);
-        Expression<T> f(inner);
-        return Expression("-sin(" + inner + ")") * f.differentiate(var);
+        Expression result = e.arity() == 0
+                                ? e.derivativeRule(var, e, nullptr, depends)
+                                : e.derivativeRule(var, lookup(e.operand(0)),
+                                                   frame.needRhs ? &lookup(e.operand(1)) : nullptr, depends);
+        cache.entries_.emplace(std::move(key), std::make_pair(e, result));
+        ++cache.misses_;
+        SYMDIFF_COUNT(DerivativeCacheMisses);
     }
-
-    return Expression("d/d" + var + "(" + e + ")");
+    return lookup(*this);
 }
 
-
-// ===== Символьная производная (complex<double>) =====
-
-template<>
-Expression<std::complex<double>> Expression<std::complex<double>>::differentiate(const std::string& var) const {
-    const std::string& e = pImpl->expr;
-
-    if (e == var) return Expression<std::complex<double>>(std::complex<double>(1.0, 0.0));
-
-    try {
-        std::stod(e);
-        return Expression<std::complex<double>>(std::complex<double>(0.0, 0.0));
-    } catch (...) {}
-
-    if (e == "sin(" + var + ")") return Expression<std::complex<double>>("cos(" + var + ")");
-    if (e == "cos(" + var + ")") return Expression<std::complex<double>>("-sin(" + var + ")");
-    if (e == "ln(" + var + ")")  return Expression<std::complex<double>>("1/(" + var + ")");
-    if (e == "exp(" + var + ")") return Expression<std::complex<double>>("exp(" + var + ")");
-
-    std::regex power_expr(var + "\\^(\\d+)");
-    std::smatch match;
-    if (std::regex_match(e, match, power_expr)) {
-        int n = std::stoi(match[1]);
-        return Expression<std::complex<double>>(
-            std::to_string(n) + " * " + var + "^" + std::to_string(n - 1)
-        );
+template<typename T>
+Expression<T> Expression<T>::derivativeRule(Symbol var, const Expression& du, const Expression* dv,
+                                            DependencyMemo& depends) const {
+    switch (kind()) {
+        case NodeKind::Constant:
+            return Expression(T(0));
+        case NodeKind::Variable:
+            return Expression(T(symbol() == var ? 1 : 0));
+        default:
+            break;
     }
 
-    size_t mul_pos = e.find("*");
-    if (mul_pos != std::string::npos) {
-        std::string left = e.substr(0, mul_pos);
-        std::string right = e.substr(mul_pos + 1);
-        Expression<std::complex<double>> left_expr(left);
-        Expression<std::complex<double>> right_expr(right);
-        return left_expr.differentiate(var) * right_expr + left_expr * right_expr.differentiate(var);
+    Expression<T> u = operand(0);
+    switch (kind()) {
+        case NodeKind::Neg: return -du;
+        case NodeKind::Sin: return cos(u) * du;
+        case NodeKind::Cos: return -sin(u) * du;
+        case NodeKind::Ln:  return du / u;
+        case NodeKind::Exp: return exp(u) * du;
+        default: break;
     }
 
-    return Expression<std::complex<double>>("d/d" + var + "(" + e + ")");
+    Expression<T> v = operand(1);
+    switch (kind()) {
+        case NodeKind::Add: return du + *dv;
+        case NodeKind::Sub: return du - *dv;
+        case NodeKind::Mul: return du * v + u * *dv;
+        case NodeKind::Div:
+            return (du * v - u * *dv) / (v ^ Expression(T(2)));
+        case NodeKind::Pow:
+            // u^c -> c * u^(c - 1) * u'
+            if (!dv) {
+                return v * (u ^ (v - Expression(T(1)))) * du;
+            }
+            // c^v -> c^v * ln(c) * v'
+            if (!dependsOn(u, var, depends)) {
+                return *this * ln(u) * *dv;
+            }
+            // u^v -> u^v * (v' * ln(u) + v * u' / u)
+            return *this * (*dv * ln(u) + v * du / u);
+        default:
+            throw std::runtime_error("Cannot differentiate expression: " + toString());
+    }
 }
 
 // ===== Явные инстанцирования =====
@@ -190,14 +270,36 @@ template Expression<double> Expression<double>::sin(const Expression<double>&);
 template Expression<double> Expression<double>::cos(const Expression<double>&);
 template Expression<double> Expression<double>::ln(const Expression<double>&);
 template Expression<double> Expression<double>::exp(const Expression<double>&);
-template Expression<double> Expression<double>::substitute(const std::string&, const double&) const;
-template Expression<double> Expression<double>::differentiate(const std::string&) const;
+template Expression<double> Expression<double>::differentiate(const std::string&, bool) const;
+template Expression<double> Expression<double>::differentiate(const std::string&, DerivativeCache<double>&, bool) const;
+template Expression<double> Expression<double>::differentiate(Symbol, bool) const;
+template Expression<double> Expression<double>::differentiate(Symbol, DerivativeCache<double>&, bool) const;
 template double Expression<double>::evaluate(const std::map<std::string, double>&) const;
+template double Expression<double>::evaluate(const Bindings<double>&) const;
 
 // complex<double>
 template Expression<std::complex<double>> Expression<std::complex<double>>::sin(const Expression<std::complex<double>>&);
 template Expression<std::complex<double>> Expression<std::complex<double>>::cos(const Expression<std::complex<double>>&);
 template Expression<std::complex<double>> Expression<std::complex<double>>::ln(const Expression<std::complex<double>>&);
 template Expression<std::complex<double>> Expression<std::complex<double>>::exp(const Expression<std::complex<double>>&);
-template Expression<std::complex<double>> Expression<std::complex<double>>::substitute(const std::string&, const std::complex<double>&) const;
-template Expression<std::complex<double>> Expression<std::complex<double>>::differentiate(const std::string&) const;
+template Expression<std::complex<double>> Expression<std::complex<double>>::differentiate(const std::string&, bool) const;
+template Expression<std::complex<double>> Expression<std::complex<double>>::differentiate(const std::string&, DerivativeCache<std::complex<double>>&, bool) const;
+template Expression<std::complex<double>> Expression<std::complex<double>>::differentiate(Symbol, bool) const;
+template Expression<std::complex<double>> Expression<std::complex<double>>::differentiate(Symbol, DerivativeCache<std::complex<double>>&, bool) const;
+template std::complex<double> Expression<std::complex<double>>::evaluate(const std::map<std::string, std::complex<double>>&) const;
+template std::complex<double> Expression<std::complex<double>>::evaluate(const Bindings<std::complex<double>>&) const;
+
+// Дуальные числа: построение и вычисление (символьное дифференцирование для них не нужно)
+template Expression<Dual<double>> Expression<Dual<double>>::sin(const Expression<Dual<double>>&);
+template Expression<Dual<double>> Expression<Dual<double>>::cos(const Expression<Dual<double>>&);
+template Expression<Dual<double>> Expression<Dual<double>>::ln(const Expression<Dual<double>>&);
+template Expression<Dual<double>> Expression<Dual<double>>::exp(const Expression<Dual<double>>&);
+template Dual<double> Expression<Dual<double>>::evaluate(const std::map<std::string, Dual<double>>&) const;
+template Dual<double> Expression<Dual<double>>::evaluate(const Bindings<Dual<double>>&) const;
+
+template Expression<HyperDual<double>> Expression<HyperDual<double>>::sin(const Expression<HyperDual<double>>&);
+template Expression<HyperDual<double>> Expression<HyperDual<double>>::cos(const Expression<HyperDual<double>>&);
+template Expression<HyperDual<double>> Expression<HyperDual<double>>::ln(const Expression<HyperDual<double>>&);
+template Expression<HyperDual<double>> Expression<HyperDual<double>>::exp(const Expression<HyperDual<double>>&);
+template HyperDual<double> Expression<HyperDual<double>>::evaluate(const std::map<std::string, HyperDual<double>>&) const;
+template HyperDual<double> Expression<HyperDual<double>>::evaluate(const Bindings<HyperDual<double>>&) const;
@@ -1,164 +1,402 @@
-#include "../include/Expression.hpp"
-#include <sstream>
-#include <cctype>
-#include <stdexcept>
-#include <memory>
-#include <map>
+#include "../include/parser.hpp"
+#include "../include/dual.hpp"
+#include "../include/stats.hpp"
+#include "../include/tokenizer.hpp"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Разбор по таблице операций (Pratt): у каждой операции есть сила связывания
+// precedence, префиксные операции ждут операнд, инфиксные сворачивают стек
+// операций с более сильной связью. Вместо рекурсивного вызова на каждый
+// уровень — один цикл и явные стеки операндов и операций, так что
+// вложенность скобок и длина цепочек не расходуют стек потока.
+//   expression := prefix* operand (infix prefix* operand)*
+//   operand    := '(' expression ')' | name '(' expression ')' | name | number
+// Знак минус прямо перед числом даёт отрицательную константу: -3 — константа,
+// -x и -(a + b) — унарный минус
+
+// Операция на стеке разбора. У скобок и вызовов precedence 0: свёртка
+// бинарных и префиксных операций на них останавливается
+struct PendingOperation {
+    enum Kind { Infix, Prefix, Group, Call } kind;
+    int precedence;
+    const void* op;   // OperatorTable::Infix, ::Prefix или ::Function
+};
+
+// Стеки разбора переиспользуются между вызовами в потоке, так что разбор
+// короткой строки не выделяет под них память. Вложенный разбор (из
+// пользовательской операции) получает собственные стеки
+template<typename T>
+class ParserStacks {
+public:
+    ParserStacks() : stacks_(slot().busy ? own_ : slot()) { stacks_.busy = true; }
+    ~ParserStacks() {
+        // Операнды держат узлы: освобождаются сразу, большие буферы не копятся
+        stacks_.operands.clear();
+        stacks_.operators.clear();
+        if (stacks_.operands.capacity() > MaxKept) std::vector<Expression<T>>().swap(stacks_.operands);
+        if (stacks_.operators.capacity() > MaxKept) std::vector<PendingOperation>().swap(stacks_.operators);
+        stacks_.busy = false;
+    }
+    ParserStacks(const ParserStacks&) = delete;
+    ParserStacks& operator=(const ParserStacks&) = delete;
+
+    std::vector<Expression<T>>& operands() { return stacks_.operands; }
+    std::vector<PendingOperation>& operators() { return stacks_.operators; }
+
+private:
+    static constexpr size_t MaxKept = 4096;
+
+    struct Stacks {
+        std::vector<Expression<T>> operands;
+        std::vector<PendingOperation> operators;
+        bool busy = false;
+    };
+    static Stacks& slot() {
+        thread_local Stacks stacks;
+        return stacks;
+    }
+
+    Stacks own_;
+    Stacks& stacks_;
+};
 
 template<typename T>
 class Parser {
 public:
-    explicit Parser(const std::string& input) : input_(input), pos_(0) {}
+    using Table = OperatorTable<T>;
+
+    Parser(std::string_view input, const Table& table, const ParseLimits& limits)
+        : tokens_(input, table.symbols().empty() ? nullptr : &table.symbols()), table_(table), limits_(limits),
+          operands_(stacks_.operands()), operators_(stacks_.operators()) {}
 
     Expression<T> parse() {
-        Expression<T> result = parseExpression();
-        skipWhitespace();
-        if (pos_ != input_.size()) {
-            throw std::runtime_error("Unexpected characters at end of expression.");
+        bool expectOperand = true;
+        while (true) {
+            const Token& token = tokens_.peek();
+            if (expectOperand) {
+                expectOperand = !readOperand(token);
+                continue;
+            }
+            if (const typename Table::Infix* op = infixOf(token)) {
+                bool right = op->associativity == Table::Associativity::Right;
+                reduce(op->precedence, right);
+                operators_.push_back({Pending::Infix, op->precedence, op});
+                countNode(token);
+                tokens_.next();
+                expectOperand = true;
+            } else if (token.kind == TokenKind::RParen && groups_ > 0) {
+                tokens_.next();
+                closeGroup();
+            } else {
+                break;
+            }
+        }
+
+        const Token& token = tokens_.peek();
+        if (groups_ > 0) {
+            reduce(0, false);
+            throw error(token, operators_.back().kind == Pending::Call ? "Expected closing ')' in function call"
+                                                                        : "Expected closing ')'");
         }
-        return result;
+        if (token.kind != TokenKind::End) {
+            throw error(token, "Unexpected characters at end of expression");
+        }
+        reduce(0, false);
+        return std::move(operands_.back());
     }
 
 private:
-    std::string input_;
-    size_t pos_;
+    using Pending = PendingOperation;
 
-    void skipWhitespace() {
-        while (pos_ < input_.size() && isspace(input_[pos_])) ++pos_;
-    }
+    Tokenizer tokens_;
+    const Table& table_;
+    ParseLimits limits_;
+    ParserStacks<T> stacks_;
+    std::vector<Expression<T>>& operands_;
+    std::vector<Pending>& operators_;
+    size_t groups_ = 0;    // открытые скобки и вызовы
+    size_t nesting_ = 0;   // они же вместе с ожидающими префиксными операциями
+    size_t nodes_ = 0;
 
-    char peek() {
-        skipWhitespace();
-        return pos_ < input_.size() ? input_[pos_] : '\0';
+    ParseError error(const Token& token, const std::string& message) const {
+        return ParseError::at(tokens_.input(), token.offset, message);
     }
 
-    char get() {
-        skipWhitespace();
-        return pos_ < input_.size() ? input_[pos_++] : '\0';
+    // Инфиксной операцией может быть встроенный знак, зарегистрированный знак или слово
+    const typename Table::Infix* infixOf(const Token& token) const {
+        switch (token.kind) {
+            case TokenKind::Plus:
+            case TokenKind::Minus:
+            case TokenKind::Star:
+            case TokenKind::Slash:
+            case TokenKind::Caret:
+            case TokenKind::Operator:
+            case TokenKind::Identifier:
+                return table_.infix(token.text);
+            default:
+                return nullptr;
+        }
     }
 
-    bool match(char expected) {
-        if (peek() == expected) {
-            ++pos_;
-            return true;
+    void countNode(const Token& token) {
+        if (limits_.maxNodes && ++nodes_ > limits_.maxNodes) {
+            throw error(token, "Expression exceeds the limit of " + std::to_string(limits_.maxNodes) + " nodes");
         }
-        return false;
     }
 
-    Expression<T> parseExpression() {
-        Expression<T> lhs = parseTerm();
-        while (true) {
-            char op = peek();
-            if (op == '+') {
-                get();
-                lhs = lhs + parseTerm();
-            } else if (op == '-') {
-                get();
-                lhs = lhs - parseTerm();
-            } else break;
+    void nest(const Token& token, Pending pending) {
+        if (limits_.maxDepth && nesting_ >= limits_.maxDepth) {
+            throw error(token, "Expression nesting exceeds the limit of " + std::to_string(limits_.maxDepth));
         }
-        return lhs;
+        ++nesting_;
+        operators_.push_back(pending);
     }
 
-    Expression<T> parseTerm() {
-        Expression<T> lhs = parseFactor();
-        while (true) {
-            char op = peek();
-            if (op == '*') {
-                get();
-                lhs = lhs * parseFactor();
-            } else if (op == '/') {
-                get();
-                lhs = lhs / parseFactor();
-            } else break;
+    // Открывающая скобка, вызов функции или префиксная операция — операнд
+    // ещё впереди, возвращается false; переменная или число — true
+    bool readOperand(const Token& token) {
+        switch (token.kind) {
+            case TokenKind::LParen:
+                nest(token, {Pending::Group, 0, nullptr});
+                ++groups_;
+                tokens_.next();
+                return false;
+            case TokenKind::Identifier: {
+                Token id = tokens_.next();
+                countNode(id);
+                if (!tokens_.match(TokenKind::LParen)) {
+                    operands_.push_back(Expression<T>(Symbol(id.text)));
+                    return true;
+                }
+                const typename Table::Function* function = table_.function(id.text);
+                if (!function) throw error(id, "Unknown function: " + std::string(id.text));
+                nest(id, {Pending::Call, 0, function});
+                ++groups_;
+                return false;
+            }
+            case TokenKind::Number:
+                countNode(token);
+                operands_.push_back(Expression<T>(T(tokens_.next().number)));
+                return true;
+            case TokenKind::Invalid:
+                if (!token.text.empty() && (token.text[0] == '.' || (token.text[0] >= '0' && token.text[0] <= '9'))) {
+                    throw error(token, "Invalid number: " + std::string(token.text));
+                }
+                break;
+            case TokenKind::End:
+            case TokenKind::RParen:
+                break;
+            default:
+                if (const typename Table::Prefix* op = table_.prefix(token.text)) {
+                    countNode(token);
+                    nest(token, {Pending::Prefix, op->precedence, op});
+                    tokens_.next();
+                    return false;
+                }
+                break;
         }
-        return lhs;
+        throw error(token, "Expected expression");
     }
 
-    Expression<T> parseFactor() {
-        Expression<T> base = parsePrimary();
-        while (peek() == '^') {
-            get();
-            Expression<T> exponent = parsePrimary();
-            base = base ^ exponent;
+    // Свёртка операций, которые связывают сильнее входящей с силой precedence.
+    // При равной силе ждёт только правоассоциативная операция после инфиксной
+    void reduce(int precedence, bool rightAssociative) {
+        while (!operators_.empty()) {
+            const Pending& top = operators_.back();
+            if (top.precedence < precedence || top.precedence == 0) break;
+            if (top.precedence == precedence && top.kind == Pending::Infix && rightAssociative) break;
+
+            Pending pending = top;
+            operators_.pop_back();
+            if (pending.kind == Pending::Prefix) {
+                --nesting_;
+                Expression<T>& operand = operands_.back();
+                operand = static_cast<const typename Table::Prefix*>(pending.op)->build(operand);
+                continue;
+            }
+            Expression<T> rhs = std::move(operands_.back());
+            operands_.pop_back();
+            Expression<T>& lhs = operands_.back();
+            lhs = static_cast<const typename Table::Infix*>(pending.op)->build(lhs, rhs);
         }
-        return base;
     }
 
-    Expression<T> parsePrimary() {
-        if (match('(')) {
-            Expression<T> expr = parseExpression();
-            if (!match(')')) throw std::runtime_error("Expected closing ')'");
-            return expr;
+    // Закрывающая скобка: свёртка до группы, для вызова — применение функции
+    void closeGroup() {
+        reduce(0, false);
+        Pending group = operators_.back();
+        operators_.pop_back();
+        --groups_;
+        --nesting_;
+        if (group.kind == Pending::Call) {
+            Expression<T>& arg = operands_.back();
+            arg = static_cast<const typename Table::Function*>(group.op)->build(arg);
         }
+    }
+};
 
-        if (isalpha(peek())) {
-            std::string id = parseIdentifier();
+// ===== Таблица операций =====
 
-            if (match('(')) {
-                Expression<T> arg = parseExpression();
-                if (!match(')')) throw std::runtime_error("Expected closing ')' in function call");
+namespace {
 
-                if (id == "sin") return Expression<T>::sin(arg);
-                if (id == "cos") return Expression<T>::cos(arg);
-                if (id == "ln")  return Expression<T>::ln(arg);
-                if (id == "exp") return Expression<T>::exp(arg);
+bool isSymbolChar(char c) {
+    return c > ' ' && c < 127 && c != '(' && c != ')' && c != '.' && c != '_'
+           && !(c >= '0' && c <= '9') && !(c >= 'a' && c <= 'z') && !(c >= 'A' && c <= 'Z');
+}
 
-                throw std::runtime_error("Unknown function: " + id);
-            }
+bool isWord(const std::string& s) {
+    return std::all_of(s.begin(), s.end(), [](char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); });
+}
 
-            return Expression<T>(id); // variable
-        }
+// Встроенные однобуквенные знаки лексер распознаёт сам
+bool isBuiltinSymbol(const std::string& s) {
+    return s.size() == 1 && std::string_view("+-*/^").find(s[0]) != std::string_view::npos;
+}
 
-        return parseNumber();
+template<typename Entry>
+const Entry* findEntry(const std::vector<Entry>& entries, const unsigned char (&byChar)[128], std::string_view key) {
+    if (key.size() == 1) {
+        unsigned char c = static_cast<unsigned char>(key[0]);
+        return c < 128 && byChar[c] ? &entries[byChar[c] - 1] : nullptr;
+    }
+    for (const Entry& entry : entries) {
+        if (entry.symbol == key) return &entry;
     }
+    return nullptr;
+}
 
-    std::string parseIdentifier() {
-        std::string id;
-        while (std::isalnum(peek()) || peek() == '_') {
-            id += get();
+template<typename Entry>
+void putEntry(std::vector<Entry>& entries, unsigned char (&byChar)[128], Entry entry) {
+    for (Entry& existing : entries) {
+        if (existing.symbol == entry.symbol) {
+            existing = std::move(entry);
+            return;
         }
-        return id;
     }
+    if (entries.size() >= 255) throw std::invalid_argument("Too many operators");
+    if (entry.symbol.size() == 1) byChar[static_cast<unsigned char>(entry.symbol[0])] = static_cast<unsigned char>(entries.size() + 1);
+    entries.push_back(std::move(entry));
+}
 
-    Expression<T> parseNumber() {
-        std::string num_str;
+} // namespace
 
-        // Обработка знака минус
-        if (peek() == '-') {
-            num_str += get();
-        }
+template<typename T>
+void OperatorTable<T>::addSymbol(const std::string& symbol, bool allowWord) {
+    if (allowWord && !symbol.empty() && isWord(symbol)) return;   // слово лексер читает как имя
+    if (symbol.empty() || !std::all_of(symbol.begin(), symbol.end(), isSymbolChar)) {
+        throw std::invalid_argument("Invalid operator symbol: '" + symbol + "'");
+    }
+    if (isBuiltinSymbol(symbol) || std::find(symbols_.begin(), symbols_.end(), symbol) != symbols_.end()) return;
+    symbols_.push_back(symbol);
+    std::stable_sort(symbols_.begin(), symbols_.end(),
+                     [](const std::string& a, const std::string& b) { return a.size() > b.size(); });
+}
 
-        bool has_digits = false;
-        while (std::isdigit(peek()) || peek() == '.') {
-            has_digits = true;
-            num_str += get();
-        }
+template<typename T>
+void OperatorTable<T>::addInfix(std::string symbol, int precedence, Associativity associativity, Binary build) {
+    if (precedence <= 0) throw std::invalid_argument("Operator precedence must be positive");
+    addSymbol(symbol, true);
+    putEntry(infix_, infixByChar_, Infix{std::move(symbol), precedence, associativity, std::move(build)});
+}
 
-        if (!has_digits) {
-            throw std::runtime_error("Expected number at position " + std::to_string(pos_));
-        }
+template<typename T>
+void OperatorTable<T>::addPrefix(std::string symbol, int precedence, Unary build) {
+    if (precedence <= 0) throw std::invalid_argument("Operator precedence must be positive");
+    addSymbol(symbol, false);
+    putEntry(prefix_, prefixByChar_, Prefix{std::move(symbol), precedence, std::move(build)});
+}
 
-        std::istringstream iss(num_str);
-        T value;
-        iss >> value;
-        if (iss.fail()) {
-            throw std::runtime_error("Invalid number: " + num_str);
+template<typename T>
+void OperatorTable<T>::addFunction(std::string name, Unary build) {
+    if (name.empty() || !isWord(name)) throw std::invalid_argument("Invalid function name: '" + name + "'");
+    for (Function& existing : functions_) {
+        if (existing.name == name) {
+            existing.build = std::move(build);
+            return;
         }
+    }
+    functions_.push_back(Function{std::move(name), std::move(build)});
+}
 
-        return Expression<T>(value);
+template<typename T>
+const typename OperatorTable<T>::Infix* OperatorTable<T>::infix(std::string_view symbol) const {
+    return findEntry(infix_, infixByChar_, symbol);
+}
+
+template<typename T>
+const typename OperatorTable<T>::Prefix* OperatorTable<T>::prefix(std::string_view symbol) const {
+    return findEntry(prefix_, prefixByChar_, symbol);
+}
+
+template<typename T>
+const typename OperatorTable<T>::Function* OperatorTable<T>::function(std::string_view name) const {
+    for (const Function& entry : functions_) {
+        if (entry.name == name) return &entry;
     }
+    return nullptr;
+}
 
+template<typename T>
+const OperatorTable<T>& OperatorTable<T>::standard() {
+    static const OperatorTable table = [] {
+        using E = Expression<T>;
+        OperatorTable t;
+        t.addInfix("+", 10, Associativity::Left, [](const E& a, const E& b) { return a + b; });
+        t.addInfix("-", 10, Associativity::Left, [](const E& a, const E& b) { return a - b; });
+        t.addInfix("*", 20, Associativity::Left, [](const E& a, const E& b) { return a * b; });
+        t.addInfix("/", 20, Associativity::Left, [](const E& a, const E& b) { return a / b; });
+        t.addInfix("^", 40, Associativity::Right, [](const E& a, const E& b) { return a ^ b; });
+        // Минус перед константой сворачивается в отрицательную константу
+        t.addPrefix("-", 30, [](const E& a) {
+            return a.kind() == NodeKind::Constant ? E(-a.value()) : -a;
+        });
+        t.addFunction("sin", [](const E& a) { return E::sin(a); });
+        t.addFunction("cos", [](const E& a) { return E::cos(a); });
+        t.addFunction("ln", [](const E& a) { return E::ln(a); });
+        t.addFunction("exp", [](const E& a) { return E::exp(a); });
+        return t;
+    }();
+    return table;
+}
 
-};
+// ===== Функции для использования извне =====
 
-// Функция для использования извне
 template<typename T>
-Expression<T> parseExpression(const std::string& input) {
-    Parser<T> parser(input);
+Expression<T> parseExpression(std::string_view input, const OperatorTable<T>& operators, const ParseLimits& limits) {
+    SYMDIFF_TIME(Parse);
+    Parser<T> parser(input, operators, limits);
     return parser.parse();
 }
 
+template<typename T>
+Expression<T> parseExpression(std::string_view input, const ParseLimits& limits) {
+    return parseExpression<T>(input, OperatorTable<T>::standard(), limits);
+}
+
+template<typename T>
+Expression<T> parseExpression(std::string_view input) {
+    return parseExpression<T>(input, OperatorTable<T>::standard(), ParseLimits());
+}
+
 // Явные инстанцирования
-template Expression<double> parseExpression(const std::string&);
-template Expression<std::complex<double>> parseExpression(const std::string&);
+template class OperatorTable<double>;
+template class OperatorTable<std::complex<double>>;
+template class OperatorTable<Dual<double>>;
+template class OperatorTable<HyperDual<double>>;
+template Expression<double> parseExpression(std::string_view);
+template Expression<std::complex<double>> parseExpression(std::string_view);
+template Expression<Dual<double>> parseExpression(std::string_view);
+template Expression<HyperDual<double>> parseExpression(std::string_view);
+template Expression<double> parseExpression(std::string_view, const ParseLimits&);
+template Expression<std::complex<double>> parseExpression(std::string_view, const ParseLimits&);
+template Expression<Dual<double>> parseExpression(std::string_view, const ParseLimits&);
+template Expression<HyperDual<double>> parseExpression(std::string_view, const ParseLimits&);
+template Expression<double> parseExpression(std::string_view, const OperatorTable<double>&, const ParseLimits&);
+template Expression<std::complex<double>> parseExpression(std::string_view, const OperatorTable<std::complex<double>>&,
+                                                          const ParseLimits&);
+template Expression<Dual<double>> parseExpression(std::string_view, const OperatorTable<Dual<double>>&,
+                                                  const ParseLimits&);
+template Expression<HyperDual<double>> parseExpression(std::string_view, const OperatorTable<HyperDual<double>>&,
+                                                       const ParseLimits&);
@@ -0,0 +1,333 @@
+#include "../include/serialize.hpp"
+#include "../include/dual.hpp"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SYMDIFF_MMAP 1
+#endif
+
+namespace {
+
+constexpr char Magic[4] = {'S', 'D', 'X', 'G'};
+constexpr uint16_t Version = 1;
+constexpr uint32_t ByteOrder = 0x01020304;
+
+template<typename T> struct ScalarTag;
+template<> struct ScalarTag<double> { static constexpr uint8_t value = 1; };
+template<> struct ScalarTag<std::complex<double>> { static constexpr uint8_t value = 2; };
+template<> struct ScalarTag<Dual<double>> { static constexpr uint8_t value = 3; };
+template<> struct ScalarTag<HyperDual<double>> { static constexpr uint8_t value = 4; };
+
+uint64_t align8(uint64_t size) { return (size + 7) & ~uint64_t(7); }
+
+// Смещения секций относительно начала буфера
+struct Layout {
+    uint64_t nameOffsets, names, constants, nodes, roots, end;
+
+    Layout(const SerializedHeader& h, size_t scalarSize) {
+        nameOffsets = align8(sizeof(SerializedHeader));
+        names = align8(nameOffsets + (uint64_t(h.symbols) + 1) * sizeof(uint32_t));
+        constants = align8(names + h.nameBytes);
+        nodes = align8(constants + uint64_t(h.constants) * scalarSize);
+        roots = align8(nodes + uint64_t(h.nodes) * sizeof(SerializedNode));
+        end = roots + uint64_t(h.roots) * sizeof(uint32_t);
+    }
+};
+
+bool isUnary(NodeKind kind) { return kind >= NodeKind::Neg && kind <= NodeKind::Exp; }
+
+// Узел операции из уже построенных операндов
+template<typename T>
+Expression<T> combine(NodeKind kind, const Expression<T>& a, const Expression<T>& b) {
+    using E = Expression<T>;
+    switch (kind) {
+        case NodeKind::Neg: return -a;
+        case NodeKind::Sin: return E::sin(a);
+        case NodeKind::Cos: return E::cos(a);
+        case NodeKind::Ln:  return E::ln(a);
+        case NodeKind::Exp: return E::exp(a);
+        case NodeKind::Add: return a + b;
+        case NodeKind::Sub: return a - b;
+        case NodeKind::Mul: return a * b;
+        case NodeKind::Div: return a / b;
+        case NodeKind::Pow: return a ^ b;
+        default: throw std::logic_error("combine: not an operation");
+    }
+}
+
+} // namespace
+
+template<typename T>
+SerializedGraph<T>::SerializedGraph(std::string_view bytes) {
+    static_assert(std::is_trivially_copyable<T>::value, "constants are stored as raw bytes");
+    if (bytes.size() < sizeof(SerializedHeader) || std::memcmp(bytes.data(), Magic, sizeof(Magic)) != 0) {
+        throw std::runtime_error("Not a serialized expression graph");
+    }
+    if (reinterpret_cast<uintptr_t>(bytes.data()) % 8 != 0) {
+        throw std::runtime_error("Serialized graph buffer must be 8-byte aligned");
+    }
+    header_ = reinterpret_cast<const SerializedHeader*>(bytes.data());
+    if (header_->version != Version) {
+        throw std::runtime_error("Unsupported serialized graph version " + std::to_string(header_->version));
+    }
+    if (header_->byteOrder != ByteOrder) {
+        throw std::runtime_error("Serialized graph has foreign byte order");
+    }
+    if (header_->scalar != ScalarTag<T>::value || header_->scalarSize != sizeof(T)) {
+        throw std::runtime_error("Serialized graph has a different value type");
+    }
+
+    Layout layout(*header_, sizeof(T));
+    if (layout.end != bytes.size()) {
+        throw std::runtime_error("Serialized graph is truncated or has trailing data");
+    }
+    const char* base = bytes.data();
+    nameOffsets_ = reinterpret_cast<const uint32_t*>(base + layout.nameOffsets);
+    names_ = base + layout.names;
+    constants_ = reinterpret_cast<const T*>(base + layout.constants);
+    nodes_ = reinterpret_cast<const SerializedNode*>(base + layout.nodes);
+    roots_ = reinterpret_cast<const uint32_t*>(base + layout.roots);
+
+    // Проверка ссылок: после неё обход не может выйти за границы или зациклиться
+    if (nameOffsets_[0] != 0 || nameOffsets_[header_->symbols] != header_->nameBytes) {
+        throw std::runtime_error("Corrupt symbol table");
+    }
+    for (uint32_t i = 0; i < header_->symbols; ++i) {
+        if (nameOffsets_[i] > nameOffsets_[i + 1]) throw std::runtime_error("Corrupt symbol table");
+    }
+    for (uint32_t i = 0; i < header_->nodes; ++i) {
+        const SerializedNode& n = nodes_[i];
+        NodeKind kind = static_cast<NodeKind>(n.kind);
+        bool valid = n.kind <= static_cast<uint32_t>(NodeKind::Pow);
+        if (valid && kind == NodeKind::Constant) valid = n.a < header_->constants;
+        else if (valid && kind == NodeKind::Variable) valid = n.a < header_->symbols;
+        else if (valid && isUnary(kind)) valid = n.a < i;
+        else if (valid) valid = n.a < i && n.b < i;
+        if (!valid) throw std::runtime_error("Corrupt node " + std::to_string(i));
+    }
+    for (uint32_t i = 0; i < header_->roots; ++i) {
+        if (roots_[i] >= header_->nodes) throw std::runtime_error("Corrupt root " + std::to_string(i));
+    }
+}
+
+template<typename T>
+std::vector<Expression<T>> SerializedGraph<T>::expressions() const {
+    using E = Expression<T>;
+    std::vector<Symbol> symbols;
+    symbols.reserve(header_->symbols);
+    for (uint32_t i = 0; i < header_->symbols; ++i) {
+        symbols.emplace_back(symbolName(i));
+    }
+
+    // Операнды стоят раньше узла, поэтому хватает одного прохода вперёд
+    std::vector<E> built;
+    built.reserve(header_->nodes);
+    for (uint32_t i = 0; i < header_->nodes; ++i) {
+        const SerializedNode& n = nodes_[i];
+        NodeKind kind = static_cast<NodeKind>(n.kind);
+        if (kind == NodeKind::Constant) built.push_back(E(constants_[n.a]));
+        else if (kind == NodeKind::Variable) built.push_back(E(symbols[n.a]));
+        else built.push_back(combine(kind, built[n.a], isUnary(kind) ? built[n.a] : built[n.b]));
+    }
+
+    std::vector<E> result;
+    result.reserve(header_->roots);
+    for (uint32_t i = 0; i < header_->roots; ++i) {
+        result.push_back(built[roots_[i]]);
+    }
+    return result;
+}
+
+template<typename T>
+Expression<T> SerializedGraph<T>::expression(size_t root) const {
+    using E = Expression<T>;
+    std::unordered_map<uint32_t, E> built;
+    std::vector<std::pair<uint32_t, bool>> stack = {{roots_[root], false}};
+    while (!stack.empty()) {
+        auto [i, expanded] = stack.back();
+        stack.pop_back();
+        if (built.count(i)) continue;
+        const SerializedNode& n = nodes_[i];
+        NodeKind kind = static_cast<NodeKind>(n.kind);
+        if (kind == NodeKind::Constant) {
+            built.emplace(i, E(constants_[n.a]));
+        } else if (kind == NodeKind::Variable) {
+            built.emplace(i, E(Symbol(symbolName(n.a))));
+        } else if (!expanded) {
+            stack.push_back({i, true});
+            if (!isUnary(kind)) stack.push_back({n.b, false});
+            stack.push_back({n.a, false});
+        } else {
+            const E& a = built.at(n.a);
+            built.emplace(i, combine(kind, a, isUnary(kind) ? a : built.at(n.b)));
+        }
+    }
+    return built.at(roots_[root]);
+}
+
+template<typename T>
+std::string serializeExpressions(const std::vector<Expression<T>>& roots) {
+    static_assert(std::is_trivially_copyable<T>::value, "constants are stored as raw bytes");
+
+    std::unordered_map<const void*, uint32_t> index;
+    std::unordered_map<uint32_t, uint32_t> symbolIndex;  // номер символа → номер в файле
+    std::vector<Symbol> symbols;
+    std::vector<T> constants;
+    std::vector<SerializedNode> nodes;
+    std::vector<uint32_t> rootIndices;
+
+    // Обход в обратном порядке без рекурсии: узел записывается после операндов
+    struct Frame {
+        Expression<T> expr;
+        bool expanded;
+    };
+    std::vector<Frame> stack;
+    for (const Expression<T>& root : roots) {
+        stack.push_back({root, false});
+        while (!stack.empty()) {
+            Frame frame = std::move(stack.back());
+            stack.pop_back();
+            const Expression<T>& e = frame.expr;
+            if (index.count(e.id())) continue;
+            if (!frame.expanded && e.arity() > 0) {
+                stack.push_back({e, true});
+                for (size_t k = e.arity(); k-- > 0;) {
+                    stack.push_back({e.operand(k), false});
+                }
+                continue;
+            }
+
+            SerializedNode node{static_cast<uint32_t>(e.kind()), 0, 0};
+            if (e.kind() == NodeKind::Constant) {
+                node.a = static_cast<uint32_t>(constants.size());
+                constants.push_back(e.value());
+            } else if (e.kind() == NodeKind::Variable) {
+                auto [it, inserted] = symbolIndex.emplace(e.symbol().id(), static_cast<uint32_t>(symbols.size()));
+                if (inserted) symbols.push_back(e.symbol());
+                node.a = it->second;
+            } else {
+                node.a = index.at(e.operand(0).id());
+                if (e.arity() > 1) node.b = index.at(e.operand(1).id());
+            }
+            index.emplace(e.id(), static_cast<uint32_t>(nodes.size()));
+            nodes.push_back(node);
+        }
+        rootIndices.push_back(index.at(root.id()));
+    }
+
+    SerializedHeader header{};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.scalar = ScalarTag<T>::value;
+    header.scalarSize = sizeof(T);
+    header.byteOrder = ByteOrder;
+    header.symbols = static_cast<uint32_t>(symbols.size());
+    std::vector<uint32_t> nameOffsets = {0};
+    std::string names;
+    for (Symbol symbol : symbols) {
+        names += symbol.name();
+        nameOffsets.push_back(static_cast<uint32_t>(names.size()));
+    }
+    header.nameBytes = static_cast<uint32_t>(names.size());
+    header.constants = static_cast<uint32_t>(constants.size());
+    header.nodes = static_cast<uint32_t>(nodes.size());
+    header.roots = static_cast<uint32_t>(rootIndices.size());
+
+    Layout layout(header, sizeof(T));
+    std::string out(layout.end, '\0');
+    auto put = [&](uint64_t offset, const void* data, size_t size) {
+        if (size > 0) std::memcpy(&out[offset], data, size);
+    };
+    put(0, &header, sizeof(header));
+    put(layout.nameOffsets, nameOffsets.data(), nameOffsets.size() * sizeof(uint32_t));
+    put(layout.names, names.data(), names.size());
+    put(layout.constants, constants.data(), constants.size() * sizeof(T));
+    put(layout.nodes, nodes.data(), nodes.size() * sizeof(SerializedNode));
+    put(layout.roots, rootIndices.data(), rootIndices.size() * sizeof(uint32_t));
+    return out;
+}
+
+template<typename T>
+std::vector<Expression<T>> deserializeExpressions(std::string_view bytes) {
+    // Буфер std::string выровнен, но срез чужой строки может быть нет
+    if (reinterpret_cast<uintptr_t>(bytes.data()) % 8 != 0) {
+        std::vector<uint64_t> aligned((bytes.size() + 7) / 8);
+        std::memcpy(aligned.data(), bytes.data(), bytes.size());
+        return SerializedGraph<T>(std::string_view(reinterpret_cast<const char*>(aligned.data()), bytes.size()))
+            .expressions();
+    }
+    return SerializedGraph<T>(bytes).expressions();
+}
+
+template<typename T>
+void saveExpressions(const std::string& path, const std::vector<Expression<T>>& roots) {
+    std::string bytes = serializeExpressions(roots);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    if (!out) throw std::runtime_error("Cannot write " + path);
+}
+
+template<typename T>
+std::vector<Expression<T>> loadExpressions(const std::string& path) {
+#ifdef SYMDIFF_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        throw std::runtime_error("Not a serialized expression graph: " + path);
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) throw std::runtime_error("Cannot map " + path);
+    try {
+        std::vector<Expression<T>> result = SerializedGraph<T>(std::string_view(static_cast<const char*>(data), size))
+                                                .expressions();
+        munmap(data, size);
+        return result;
+    } catch (...) {
+        munmap(data, size);
+        throw;
+    }
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open " + path);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return deserializeExpressions<T>(bytes);
+#endif
+}
+
+// Явные инстанцирования
+template class SerializedGraph<double>;
+template class SerializedGraph<std::complex<double>>;
+template class SerializedGraph<Dual<double>>;
+template class SerializedGraph<HyperDual<double>>;
+
+template std::string serializeExpressions(const std::vector<Expression<double>>&);
+template std::string serializeExpressions(const std::vector<Expression<std::complex<double>>>&);
+template std::string serializeExpressions(const std::vector<Expression<Dual<double>>>&);
+template std::string serializeExpressions(const std::vector<Expression<HyperDual<double>>>&);
+
+template std::vector<Expression<double>> deserializeExpressions(std::string_view);
+template std::vector<Expression<std::complex<double>>> deserializeExpressions(std::string_view);
+template std::vector<Expression<Dual<double>>> deserializeExpressions(std::string_view);
+template std::vector<Expression<HyperDual<double>>> deserializeExpressions(std::string_view);
+
+template void saveExpressions(const std::string&, const std::vector<Expression<double>>&);
+template void saveExpressions(const std::string&, const std::vector<Expression<std::complex<double>>>&);
+template void saveExpressions(const std::string&, const std::vector<Expression<Dual<double>>>&);
+template void saveExpressions(const std::string&, const std::vector<Expression<HyperDual<double>>>&);
+
+template std::vector<Expression<double>> loadExpressions(const std::string&);
+template std::vector<Expression<std::complex<double>>> loadExpressions(const std::string&);
+template std::vector<Expression<Dual<double>>> loadExpressions(const std::string&);
+template std::vector<Expression<HyperDual<double>>> loadExpressions(const std::string&);
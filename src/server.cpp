@@ -0,0 +1,365 @@
+#include "../include/server.hpp"
+#include "../include/json.hpp"
+#include "../include/parser.hpp"
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define SYMDIFF_UNIX_SOCKETS 1
+#endif
+
+namespace {
+
+std::string describe(uint64_t handle, const Expression<double>& expr,
+                     const CompiledExpression<double>& program) {
+    std::string out = "{\"handle\":" + std::to_string(handle) + ",\"expression\":" + jsonQuote(expr.toString())
+                    + ",\"variables\":[";
+    for (size_t i = 0; i < program.variables().size(); ++i) {
+        if (i > 0) out += ',';
+        out += jsonQuote(program.variables()[i]);
+    }
+    return out + "]}";
+}
+
+// Значения переменных программы в порядке её слотов
+std::vector<double> slotsFrom(const CompiledExpression<double>& program, const JsonValue* bindings) {
+    std::vector<double> slots;
+    for (const std::string& name : program.variables()) {
+        const JsonValue* value = bindings ? bindings->find(name) : nullptr;
+        if (!value || value->type != JsonValue::Type::Number) {
+            throw std::runtime_error("Unknown variable: " + name);
+        }
+        slots.push_back(value->number);
+    }
+    return slots;
+}
+
+// Дескриптор — целое число в [0, 2^53): дробные, отрицательные, бесконечные
+// и слишком большие числа double не переводятся в uint64_t без потерь
+uint64_t handleFrom(const JsonValue& value) {
+    if (value.type != JsonValue::Type::Number || !(value.number >= 0) || value.number >= 9007199254740992.0
+        || value.number != std::floor(value.number)) {
+        throw std::runtime_error("Invalid handle");
+    }
+    return static_cast<uint64_t>(value.number);
+}
+
+} // namespace
+
+std::shared_ptr<const ExpressionServer::Entry> ExpressionServer::intern(const Expression<double>& expr) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = byNode_.find(expr.id());
+        if (it != byNode_.end()) {
+            Slot& slot = entries_.at(it->second);
+            ++slot.references;
+            return slot.entry;
+        }
+    }
+    // Компиляция вне блокировки; при гонке побеждает первая запись
+    CompiledExpression<double> program = compile(expr);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto [it, inserted] = byNode_.emplace(expr.id(), nextHandle_);
+    if (!inserted) {
+        Slot& slot = entries_.at(it->second);
+        ++slot.references;
+        return slot.entry;
+    }
+    auto entry = std::make_shared<const Entry>(Entry{nextHandle_, expr, std::move(program)});
+    entries_.emplace(nextHandle_++, Slot{entry, 1});
+    return entry;
+}
+
+std::shared_ptr<const ExpressionServer::Entry> ExpressionServer::transient(const Expression<double>& expr) const {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = byNode_.find(expr.id());
+        if (it != byNode_.end()) return entries_.at(it->second).entry;
+    }
+    return std::make_shared<const Entry>(Entry{0, expr, compile(expr)});
+}
+
+std::shared_ptr<const ExpressionServer::Entry> ExpressionServer::lookup(uint64_t handle, bool acquire) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(handle);
+    if (it == entries_.end()) {
+        throw std::runtime_error("Unknown handle: " + std::to_string(handle));
+    }
+    if (acquire) ++it->second.references;
+    return it->second.entry;
+}
+
+bool ExpressionServer::release(uint64_t handle) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(handle);
+    if (it == entries_.end()) return false;
+    if (--it->second.references == 0) {
+        byNode_.erase(it->second.entry->expr.id());
+        entries_.erase(it);
+    }
+    return true;
+}
+
+size_t ExpressionServer::handles() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+std::string ExpressionServer::handle(std::string_view request) {
+    try {
+        JsonValue message = parseJson(request, jsonDepthFor(limits_.maxDepth));
+        const JsonValue* op = message.find("op");
+        if (!op || op->type != JsonValue::Type::String) {
+            throw std::runtime_error("Missing \"op\"");
+        }
+
+        // Выражение запроса: по дескриптору или из текста. keep — ответ вернёт
+        // дескриптор, и клиент получает на него ссылку
+        auto target = [&](bool keep) {
+            if (const JsonValue* handle = message.find("handle")) {
+                return lookup(handleFrom(*handle), keep);
+            }
+            const JsonValue* expression = message.find("expression");
+            if (!expression || expression->type != JsonValue::Type::String) {
+                throw std::runtime_error("Missing \"handle\" or \"expression\"");
+            }
+            Expression<double> expr = parseExpression<double>(expression->string, limits_);
+            return keep ? intern(expr) : transient(expr);
+        };
+
+        if (op->string == "parse") {
+            auto entry = target(true);
+            return describe(entry->handle, entry->expr, entry->program);
+        }
+        if (op->string == "diff") {
+            const JsonValue* variable = message.find("variable");
+            if (!variable || variable->type != JsonValue::Type::String) {
+                throw std::runtime_error("Missing \"variable\"");
+            }
+            auto entry = intern(target(false)->expr.differentiate(variable->string));
+            return describe(entry->handle, entry->expr, entry->program);
+        }
+        if (op->string == "eval") {
+            auto entry = target(false);
+            std::vector<double> slots = slotsFrom(entry->program, message.find("bindings"));
+            return "{\"value\":" + jsonNumber(entry->program.eval(slots.data())) + "}";
+        }
+        if (op->string == "gradient") {
+            auto entry = target(false);
+            std::vector<double> slots = slotsFrom(entry->program, message.find("bindings"));
+            std::vector<double> grad(slots.size());
+            double value = entry->program.gradient(slots.data(), grad.data());
+            std::string out = "{\"value\":" + jsonNumber(value) + ",\"gradient\":{";
+            for (size_t i = 0; i < grad.size(); ++i) {
+                if (i > 0) out += ',';
+                out += jsonQuote(entry->program.variables()[i]) + ":" + jsonNumber(grad[i]);
+            }
+            return out + "}}";
+        }
+        if (op->string == "release") {
+            const JsonValue* handle = message.find("handle");
+            if (!handle) throw std::runtime_error("Missing \"handle\"");
+            bool released = release(handleFrom(*handle));
+            return std::string("{\"released\":") + (released ? "true" : "false") + "}";
+        }
+        throw std::runtime_error("Unknown op: " + op->string);
+    } catch (const ParseError& ex) {
+        return "{\"error\":" + jsonQuote(ex.what()) + ",\"offset\":" + std::to_string(ex.offset())
+               + ",\"line\":" + std::to_string(ex.line()) + ",\"column\":" + std::to_string(ex.column()) + "}";
+    } catch (const std::exception& ex) {
+        return "{\"error\":" + jsonQuote(ex.what()) + "}";
+    }
+}
+
+std::string processRecord(std::string_view line, const ParseLimits& limits) {
+    try {
+        JsonValue record = parseJson(line, jsonDepthFor(limits.maxDepth));
+        const JsonValue* expression = record.find("expression");
+        if (!expression || expression->type != JsonValue::Type::String) {
+            throw std::runtime_error("Missing \"expression\"");
+        }
+        Expression<double> expr = parseExpression<double>(expression->string, limits);
+        std::string out = "{";
+
+        const JsonValue* variable = record.find("variable");
+        if (variable && variable->type == JsonValue::Type::String) {
+            expr = expr.differentiate(variable->string);
+            out += "\"derivative\":" + jsonQuote(expr.toString());
+        } else {
+            out += "\"expression\":" + jsonQuote(expr.toString());
+        }
+
+        const JsonValue* bindings = record.find("bindings");
+        if (bindings && bindings->type == JsonValue::Type::Object) {
+            Bindings<double> values;
+            for (const auto& [name, value] : bindings->object) {
+                if (value.type != JsonValue::Type::Number) {
+                    throw std::runtime_error("Binding \"" + name + "\" is not a number");
+                }
+                values.set(Symbol(name), value.number);
+            }
+            out += ",\"value\":" + jsonNumber(expr.evaluate(values));
+        }
+        return out + "}";
+    } catch (const std::exception& ex) {
+        return "{\"error\":" + jsonQuote(ex.what()) + "}";
+    }
+}
+
+#ifdef SYMDIFF_UNIX_SOCKETS
+
+namespace {
+
+// Строка запроса длиннее — ошибка, соединение закрывается: иначе клиент
+// без перевода строки заставляет копить буфер без предела
+constexpr size_t MaxRequestLine = 1 << 20;
+
+// Одновременно обслуживаемых соединений не больше; следующие ждут в очереди
+// listen, пока не закроется одно из открытых
+constexpr size_t MaxConnections = 64;
+
+// Сигнал SIGPIPE при записи в закрытое соединение подавляется флагом send,
+// а где его нет (macOS) — опцией SO_NOSIGPIPE сокета соединения
+#ifdef MSG_NOSIGNAL
+constexpr int SendFlags = MSG_NOSIGNAL;
+#else
+constexpr int SendFlags = 0;
+#endif
+
+// Счётчик занятых мест для соединений
+class ConnectionSlots {
+public:
+    void acquire() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        freed_.wait(lock, [this] { return used_ < MaxConnections; });
+        ++used_;
+    }
+    void release() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --used_;
+        }
+        freed_.notify_one();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable freed_;
+    size_t used_ = 0;
+};
+
+std::string tooLong() {
+    return "{\"error\":\"Request line exceeds " + std::to_string(MaxRequestLine) + " bytes\"}";
+}
+
+// Соединение: запросы разделены переводом строки, ответы пишутся в том же порядке
+void serveConnection(int fd, ExpressionServer& server) {
+    std::string buffer;
+    std::string reply;
+    char chunk[64 * 1024];
+    while (true) {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) break;
+        // Начало буфера уже просмотрено: перевод строки ищется только в новых байтах
+        size_t scanned = buffer.size();
+        buffer.append(chunk, static_cast<size_t>(n));
+
+        reply.clear();
+        size_t start = 0;
+        for (size_t eol; (eol = buffer.find('\n', scanned)) != std::string::npos; start = scanned = eol + 1) {
+            std::string_view line(buffer.data() + start, eol - start);
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if (line.empty()) continue;
+            reply += line.size() > MaxRequestLine ? tooLong() : server.handle(line);
+            reply += '\n';
+        }
+        buffer.erase(0, start);
+        const bool overflow = buffer.size() > MaxRequestLine;
+        if (overflow) reply += tooLong() + '\n';
+
+        // Все ответы на пришедшую порцию запросов уходят одной записью
+        for (size_t sent = 0; sent < reply.size();) {
+            ssize_t m = send(fd, reply.data() + sent, reply.size() - sent, SendFlags);
+            if (m <= 0) {
+                close(fd);
+                return;
+            }
+            sent += static_cast<size_t>(m);
+        }
+        if (overflow) break;
+    }
+    close(fd);
+}
+
+} // namespace
+
+void serveUnixSocket(const std::string& path, ExpressionServer& server) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path too long: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    // Удаляется только оставшийся от прежнего запуска сокет: путь с обычным
+    // файлом или каталогом — ошибка, а не повод его стереть
+    struct stat existing;
+    if (lstat(path.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            throw std::runtime_error("Cannot listen on " + path + ": path exists and is not a socket");
+        }
+        unlink(path.c_str());
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+    }
+    if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0
+        || listen(listener, 128) < 0) {
+        int error = errno;
+        close(listener);
+        throw std::runtime_error("Cannot listen on " + path + ": " + std::strerror(error));
+    }
+
+    // Потоки соединений переживают выход по ошибке accept, поэтому счётчик общий
+    auto slots = std::make_shared<ConnectionSlots>();
+    while (true) {
+        slots->acquire();
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            slots->release();
+            if (errno == EINTR) continue;
+            int error = errno;
+            close(listener);
+            throw std::runtime_error(std::string("accept: ") + std::strerror(error));
+        }
+#ifdef SO_NOSIGPIPE
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+        std::thread([fd, &server, slots] {
+            serveConnection(fd, server);
+            slots->release();
+        }).detach();
+    }
+}
+
+#else
+
+void serveUnixSocket(const std::string&, ExpressionServer&) {
+    throw std::runtime_error("Unix domain sockets are not available on this platform");
+}
+
+#endif
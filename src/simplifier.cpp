@@ -0,0 +1,417 @@
+#include "../include/Expression.hpp"
+#include "../include/stats.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+template<typename T>
+bool isNegative(const T& value) {
+    if constexpr (std::is_same_v<T, std::complex<double>>) {
+        return value.imag() == 0.0 && value.real() < 0.0;
+    } else {
+        return value < 0;
+    }
+}
+
+template<typename T>
+bool isInteger(const T& value) {
+    if constexpr (std::is_same_v<T, std::complex<double>>) {
+        return value.imag() == 0.0 && std::floor(value.real()) == value.real();
+    } else {
+        return std::floor(value) == value;
+    }
+}
+
+template<typename T>
+bool isFinite(const T& value) {
+    if constexpr (std::is_same_v<T, std::complex<double>>) {
+        return std::isfinite(value.real()) && std::isfinite(value.imag());
+    } else {
+        return std::isfinite(value);
+    }
+}
+
+template<typename T>
+int compareValues(const T& a, const T& b) {
+    if constexpr (std::is_same_v<T, std::complex<double>>) {
+        if (a.real() != b.real()) return a.real() < b.real() ? -1 : 1;
+        if (a.imag() != b.imag()) return a.imag() < b.imag() ? -1 : 1;
+        return 0;
+    } else {
+        return a < b ? -1 : (b < a ? 1 : 0);
+    }
+}
+
+// Полный структурный порядок: различает узлы с равными ключами в Simplifier::before
+template<typename T>
+int compareNodes(const Expression<T>& a, const Expression<T>& b) {
+    // Пары операндов сравниваются слева направо по явному стеку
+    std::vector<std::pair<Expression<T>, Expression<T>>> stack = {{a, b}};
+    while (!stack.empty()) {
+        auto [x, y] = std::move(stack.back());
+        stack.pop_back();
+        if (x == y) continue;
+        if (x.kind() != y.kind()) return x.kind() < y.kind() ? -1 : 1;
+        switch (x.kind()) {
+            case NodeKind::Constant:
+                if (int c = compareValues(x.value(), y.value())) return c;
+                continue;
+            case NodeKind::Variable:
+                if (int c = x.name().compare(y.name())) return c < 0 ? -1 : 1;
+                continue;
+            default:
+                break;
+        }
+        for (size_t i = x.arity(); i-- > 0;) stack.emplace_back(x.operand(i), y.operand(i));
+    }
+    return 0;
+}
+
+// Хэш значения для ключа порядка: зависит только от числа, а не от адресов узлов
+template<typename T>
+size_t valueHash(const T& value) {
+    if constexpr (std::is_same_v<T, std::complex<double>>) {
+        return std::hash<double>()(value.real()) * 31 + std::hash<double>()(value.imag());
+    } else {
+        return std::hash<double>()(value);
+    }
+}
+
+template<typename T>
+bool isConstant(const Expression<T>& e, const T& value) {
+    return e.kind() == NodeKind::Constant && e.value() == value;
+}
+
+// Упрощение снизу вверх с запоминанием уже обработанных узлов:
+// общие подвыражения DAG обрабатываются по одному разу. Обход идёт
+// по явному стеку, так что узел упрощается, когда его операнды уже в done_
+template<typename T>
+class Simplifier {
+public:
+    Expression<T> run(const Expression<T>& root) {
+        auto it = done_.find(root.id());
+        if (it != done_.end()) return it->second.second;
+
+        std::vector<std::pair<Expression<T>, bool>> stack = {{root, false}};
+        while (!stack.empty()) {
+            SYMDIFF_MAX(MaxStackDepth, stack.size());
+            auto [e, ready] = std::move(stack.back());
+            stack.pop_back();
+            if (done_.count(e.id())) continue;
+            if (!ready) {
+                stack.emplace_back(e, true);
+                for (size_t i = e.arity(); i-- > 0;) stack.emplace_back(e.operand(i), false);
+                continue;
+            }
+            Expression<T> result = simplifyNode(e);
+            done_.emplace(e.id(), std::make_pair(e, std::move(result)));
+        }
+        return done_.at(root.id()).second;
+    }
+
+private:
+    using Term = std::pair<T, Expression<T>>;          // коэффициент * одночлен
+    using Factor = std::pair<Expression<T>, Expression<T>>;  // основание ^ показатель
+
+    // Ключ хранится вместе с результатом, чтобы адрес узла не переиспользовался
+    std::unordered_map<const void*, std::pair<Expression<T>, Expression<T>>> done_;
+    // Структурный хэш узла для канонического порядка, считается один раз на узел
+    std::unordered_map<const void*, std::pair<Expression<T>, size_t>> keys_;
+
+    size_t orderKey(const Expression<T>& root) {
+        auto it = keys_.find(root.id());
+        if (it != keys_.end()) return it->second.second;
+
+        std::vector<std::pair<Expression<T>, bool>> stack = {{root, false}};
+        while (!stack.empty()) {
+            auto [e, ready] = std::move(stack.back());
+            stack.pop_back();
+            if (keys_.count(e.id())) continue;
+            if (!ready && e.arity() > 0) {
+                stack.emplace_back(e, true);
+                for (size_t i = e.arity(); i-- > 0;) stack.emplace_back(e.operand(i), false);
+                continue;
+            }
+            size_t key = static_cast<size_t>(e.kind());
+            if (e.kind() == NodeKind::Constant) key = key * 31 + valueHash(e.value());
+            if (e.kind() == NodeKind::Variable) key = key * 31 + std::hash<std::string>()(e.name());
+            for (size_t i = 0; i < e.arity(); ++i) {
+                key = key * 1000003u ^ keys_.at(e.operand(i).id()).second;
+            }
+            keys_.emplace(e.id(), std::make_pair(e, key));
+        }
+        return keys_.at(root.id()).second;
+    }
+
+    // Канонический порядок слагаемых и множителей: вид узла, для листьев —
+    // значение или имя, для остальных — структурный хэш. Полное структурное
+    // сравнение нужно только при совпадении хэшей, поэтому сортировка широкой
+    // суммы глубоких подвыражений не спускается в них на каждом сравнении
+    bool before(const Expression<T>& a, const Expression<T>& b) {
+        if (a == b) return false;
+        if (a.kind() != b.kind()) return a.kind() < b.kind();
+        if (a.kind() == NodeKind::Constant || a.kind() == NodeKind::Variable) return compareNodes(a, b) < 0;
+        size_t ka = orderKey(a);
+        size_t kb = orderKey(b);
+        if (ka != kb) return ka < kb;
+        return compareNodes(a, b) < 0;
+    }
+
+    Expression<T> simplifyNode(const Expression<T>& e) {
+        switch (e.kind()) {
+            case NodeKind::Constant:
+            case NodeKind::Variable:
+                return e;
+            case NodeKind::Neg:
+            case NodeKind::Add:
+            case NodeKind::Sub:
+                return simplifySum(e);
+            case NodeKind::Mul:
+            case NodeKind::Div:
+                return simplifyProduct(e);
+            case NodeKind::Pow:
+                return simplifyPower(run(e.operand(0)), run(e.operand(1)));
+            default:
+                return simplifyFunction(e.kind(), run(e.operand(0)));
+        }
+    }
+
+    // ===== Функции =====
+
+    Expression<T> simplifyFunction(NodeKind kind, const Expression<T>& arg) {
+        if (arg.kind() == NodeKind::Constant) {
+            T v = arg.value();
+            T folded = kind == NodeKind::Sin ? std::sin(v)
+                     : kind == NodeKind::Cos ? std::cos(v)
+                     : kind == NodeKind::Ln  ? std::log(v)
+                     : std::exp(v);
+            if (isFinite(folded)) return Expression<T>(folded);
+        }
+        // ln(exp(u)) = u
+        if (kind == NodeKind::Ln && arg.kind() == NodeKind::Exp) {
+            return arg.operand(0);
+        }
+        switch (kind) {
+            case NodeKind::Sin: return Expression<T>::sin(arg);
+            case NodeKind::Cos: return Expression<T>::cos(arg);
+            case NodeKind::Ln:  return Expression<T>::ln(arg);
+            default:            return Expression<T>::exp(arg);
+        }
+    }
+
+    // ===== Суммы: a + b - c как набор одночленов с коэффициентами =====
+
+    // Одночлены собираются слева направо: правый операнд кладётся в стек первым
+    void collectTerms(const Expression<T>& root, T& constant, std::vector<Term>& terms) {
+        std::vector<std::pair<Expression<T>, T>> stack = {{root, T(1)}};
+        while (!stack.empty()) {
+            auto [e, sign] = std::move(stack.back());
+            stack.pop_back();
+            switch (e.kind()) {
+                case NodeKind::Constant:
+                    constant += sign * e.value();
+                    continue;
+                case NodeKind::Neg:
+                    stack.emplace_back(run(e.operand(0)), -sign);
+                    continue;
+                case NodeKind::Add:
+                    stack.emplace_back(run(e.operand(1)), sign);
+                    stack.emplace_back(run(e.operand(0)), sign);
+                    continue;
+                case NodeKind::Sub:
+                    stack.emplace_back(run(e.operand(1)), -sign);
+                    stack.emplace_back(run(e.operand(0)), sign);
+                    continue;
+                case NodeKind::Mul:
+                    // Канонические произведения держат коэффициент в левом операнде
+                    if (e.operand(0).kind() == NodeKind::Constant) {
+                        terms.emplace_back(sign * e.operand(0).value(), e.operand(1));
+                        continue;
+                    }
+                    break;
+                default:
+                    break;
+            }
+            terms.emplace_back(sign, e);
+        }
+    }
+
+    Expression<T> simplifySum(const Expression<T>& e) {
+        T constant(0);
+        std::vector<Term> raw;
+        collectTerms(e, constant, raw);
+
+        // Приведение подобных: одинаковые одночлены — один и тот же узел
+        std::vector<Term> terms;
+        std::unordered_map<const void*, size_t> index;
+        for (const auto& [coeff, term] : raw) {
+            auto [it, inserted] = index.emplace(term.id(), terms.size());
+            if (inserted) {
+                terms.emplace_back(coeff, term);
+            } else {
+                terms[it->second].first += coeff;
+            }
+        }
+        terms.erase(std::remove_if(terms.begin(), terms.end(),
+                                   [](const Term& t) { return t.first == T(0); }),
+                    terms.end());
+        std::stable_sort(terms.begin(), terms.end(), [this](const Term& a, const Term& b) {
+            return before(a.second, b.second);
+        });
+
+        if (terms.empty()) return Expression<T>(constant);
+
+        auto scaled = [](const T& coeff, const Expression<T>& term) {
+            return coeff == T(1) ? term : Expression<T>(coeff) * term;
+        };
+
+        const Term& first = terms.front();
+        Expression<T> result = first.first == T(-1) ? -first.second : scaled(first.first, first.second);
+        for (size_t i = 1; i < terms.size(); ++i) {
+            const auto& [coeff, term] = terms[i];
+            result = isNegative(coeff) ? result - scaled(-coeff, term) : result + scaled(coeff, term);
+        }
+        if (constant != T(0)) {
+            result = isNegative(constant) ? result - Expression<T>(-constant) : result + Expression<T>(constant);
+        }
+        return result;
+    }
+
+    // ===== Произведения: a * b / c как набор оснований с показателями =====
+
+    void collectFactors(const Expression<T>& root, T& coeff, std::vector<Factor>& factors) {
+        std::vector<std::pair<Expression<T>, bool>> stack = {{root, false}};
+        while (!stack.empty()) {
+            auto [e, inverse] = std::move(stack.back());
+            stack.pop_back();
+            switch (e.kind()) {
+                case NodeKind::Constant:
+                    coeff = inverse ? coeff / e.value() : coeff * e.value();
+                    break;
+                case NodeKind::Neg:
+                    coeff = -coeff;
+                    stack.emplace_back(run(e.operand(0)), inverse);
+                    break;
+                case NodeKind::Mul:
+                    stack.emplace_back(run(e.operand(1)), inverse);
+                    stack.emplace_back(run(e.operand(0)), inverse);
+                    break;
+                case NodeKind::Div:
+                    stack.emplace_back(run(e.operand(1)), !inverse);
+                    stack.emplace_back(run(e.operand(0)), inverse);
+                    break;
+                case NodeKind::Pow:
+                    factors.emplace_back(e.operand(0), inverse ? negate(e.operand(1)) : e.operand(1));
+                    break;
+                default:
+                    factors.emplace_back(e, Expression<T>(T(inverse ? -1 : 1)));
+                    break;
+            }
+        }
+    }
+
+    Expression<T> negate(const Expression<T>& e) {
+        return e.kind() == NodeKind::Constant ? Expression<T>(-e.value()) : run(-e);
+    }
+
+    Expression<T> simplifyProduct(const Expression<T>& e) {
+        // Деление на нулевую константу не сворачивается
+        if (e.kind() == NodeKind::Div) {
+            Expression<T> den = run(e.operand(1));
+            if (isConstant(den, T(0))) return run(e.operand(0)) / den;
+        }
+
+        T coeff(1);
+        std::vector<Factor> raw;
+        collectFactors(e, coeff, raw);
+        if (coeff == T(0)) return Expression<T>(T(0));
+
+        // Слияние степеней одного основания: x^a * x^b = x^(a + b)
+        std::vector<Factor> factors;
+        std::unordered_map<const void*, size_t> index;
+        for (const auto& [base, exponent] : raw) {
+            auto [it, inserted] = index.emplace(base.id(), factors.size());
+            if (inserted) {
+                factors.emplace_back(base, exponent);
+            } else {
+                Expression<T>& merged = factors[it->second].second;
+                merged = run(merged + exponent);
+            }
+        }
+        factors.erase(std::remove_if(factors.begin(), factors.end(),
+                                     [](const Factor& f) { return isConstant(f.second, T(0)); }),
+                      factors.end());
+        std::stable_sort(factors.begin(), factors.end(), [this](const Factor& a, const Factor& b) {
+            return before(a.first, b.first);
+        });
+
+        std::vector<Expression<T>> num;
+        std::vector<Expression<T>> den;
+        for (const auto& [base, exponent] : factors) {
+            if (exponent.kind() == NodeKind::Constant && isNegative(exponent.value())) {
+                den.push_back(power(base, Expression<T>(-exponent.value())));
+            } else {
+                num.push_back(power(base, exponent));
+            }
+        }
+
+        auto product = [](const std::vector<Expression<T>>& items) {
+            Expression<T> result = items.front();
+            for (size_t i = 1; i < items.size(); ++i) result = result * items[i];
+            return result;
+        };
+
+        if (num.empty() && den.empty()) return Expression<T>(coeff);
+        Expression<T> body = num.empty() ? Expression<T>(T(1)) : product(num);
+        if (!den.empty()) body = body / product(den);
+        if (num.empty() && coeff != T(1)) {
+            // 2 / x: коэффициент становится числителем
+            return coeff == T(-1) ? -body : Expression<T>(coeff) / product(den);
+        }
+        if (coeff == T(1)) return body;
+        if (coeff == T(-1)) return -body;
+        return Expression<T>(coeff) * body;
+    }
+
+    static Expression<T> power(const Expression<T>& base, const Expression<T>& exponent) {
+        return isConstant(exponent, T(1)) ? base : base ^ exponent;
+    }
+
+    // ===== Степени =====
+
+    Expression<T> simplifyPower(const Expression<T>& base, const Expression<T>& exponent) {
+        if (base.kind() == NodeKind::Constant && exponent.kind() == NodeKind::Constant) {
+            T folded = std::pow(base.value(), exponent.value());
+            if (isFinite(folded)) return Expression<T>(folded);
+        }
+        if (isConstant(exponent, T(0))) return Expression<T>(T(1));
+        if (isConstant(exponent, T(1))) return base;
+        if (isConstant(base, T(1))) return base;
+        // (u^a)^n = u^(a n) только для целых n
+        if (base.kind() == NodeKind::Pow && exponent.kind() == NodeKind::Constant
+            && isInteger(exponent.value())) {
+            return simplifyPower(base.operand(0), run(base.operand(1) * exponent));
+        }
+        return base ^ exponent;
+    }
+};
+
+} // namespace
+
+template<typename T>
+Expression<T> Expression<T>::simplify() const {
+    SYMDIFF_TIME(Simplify);
+    Simplifier<T> simplifier;
+    return simplifier.run(*this);
+}
+
+// ===== Явные инстанцирования =====
+
+template Expression<double> Expression<double>::simplify() const;
+template Expression<std::complex<double>> Expression<std::complex<double>>::simplify() const;
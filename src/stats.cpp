@@ -0,0 +1,110 @@
+#include "../include/stats.hpp"
+#include "../include/json.hpp"
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+std::mutex& registryMutex() {
+    static std::mutex* mutex = new std::mutex;
+    return *mutex;
+}
+
+const char* const CounterNames[] = {
+    "nodes_created", "nodes_reused", "slab_allocations",
+    "derivative_cache_hits", "derivative_cache_misses", "tokens_read", "max_stack_depth",
+};
+const char* const TimerNames[] = {
+    "parse", "differentiate", "simplify", "evaluate", "substitute", "compile",
+};
+
+static_assert(sizeof(CounterNames) / sizeof(CounterNames[0]) == Stats::CounterCount, "counter names");
+static_assert(sizeof(TimerNames) / sizeof(TimerNames[0]) == Stats::TimerCount, "timer names");
+
+} // namespace
+
+// Блоки не освобождаются: статистика завершившихся потоков входит в сумму
+std::vector<Stats::Block*>& Stats::blocks() {
+    static auto* blocks = new std::vector<Block*>;
+    return *blocks;
+}
+
+Stats::Block* Stats::registerBlock() {
+    Block* block = new Block;
+    std::lock_guard<std::mutex> lock(registryMutex());
+    blocks().push_back(block);
+    return block;
+}
+
+Stats::Snapshot Stats::snapshot() {
+    Snapshot total;
+    std::lock_guard<std::mutex> lock(registryMutex());
+    for (const Block* block : blocks()) {
+        for (size_t i = 0; i < CounterCount; ++i) {
+            uint64_t value = block->counters[i].load(std::memory_order_relaxed);
+            if (i == index(Counter::MaxStackDepth)) {
+                if (value > total.counters[i]) total.counters[i] = value;
+            } else {
+                total.counters[i] += value;
+            }
+        }
+        for (size_t i = 0; i < TimerCount; ++i) {
+            total.calls[i] += block->calls[i].load(std::memory_order_relaxed);
+            total.nanoseconds[i] += block->nanoseconds[i].load(std::memory_order_relaxed);
+        }
+    }
+    return total;
+}
+
+// Сброс из другого потока может потеряться, если владелец блока как раз пишет
+void Stats::reset() {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    for (Block* block : blocks()) {
+        for (auto& counter : block->counters) counter.store(0, std::memory_order_relaxed);
+        for (auto& calls : block->calls) calls.store(0, std::memory_order_relaxed);
+        for (auto& ns : block->nanoseconds) ns.store(0, std::memory_order_relaxed);
+    }
+}
+
+const char* Stats::name(Counter counter) { return CounterNames[index(counter)]; }
+const char* Stats::name(Timer timer) { return TimerNames[index(timer)]; }
+
+std::string Stats::report() {
+    if (!enabled()) return "statistics disabled at build time (rebuild with -DSYMDIFF_STATS)\n";
+
+    Snapshot s = snapshot();
+    std::string out;
+    char line[128];
+    for (size_t i = 0; i < CounterCount; ++i) {
+        std::snprintf(line, sizeof(line), "%-26s %14llu\n", CounterNames[i],
+                      static_cast<unsigned long long>(s.counters[i]));
+        out += line;
+    }
+    std::snprintf(line, sizeof(line), "%-26s %14s %14s %12s\n", "timer", "calls", "total ms", "us/call");
+    out += line;
+    for (size_t i = 0; i < TimerCount; ++i) {
+        if (s.calls[i] == 0) continue;
+        std::snprintf(line, sizeof(line), "%-26s %14llu %14.3f %12.3f\n", TimerNames[i],
+                      static_cast<unsigned long long>(s.calls[i]), s.nanoseconds[i] / 1e6,
+                      s.nanoseconds[i] / 1e3 / s.calls[i]);
+        out += line;
+    }
+    return out;
+}
+
+std::string Stats::json() {
+    Snapshot s = snapshot();
+    std::string out = "{\"enabled\":" + std::string(enabled() ? "true" : "false") + ",\"counters\":{";
+    for (size_t i = 0; i < CounterCount; ++i) {
+        if (i > 0) out += ',';
+        out += jsonQuote(CounterNames[i]) + ":" + std::to_string(s.counters[i]);
+    }
+    out += "},\"timers\":{";
+    for (size_t i = 0; i < TimerCount; ++i) {
+        if (i > 0) out += ',';
+        out += jsonQuote(TimerNames[i]) + ":{\"calls\":" + std::to_string(s.calls[i])
+             + ",\"ns\":" + std::to_string(s.nanoseconds[i]) + "}";
+    }
+    return out + "}}";
+}
@@ -0,0 +1,60 @@
+#include "../include/symbol.hpp"
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+
+// Имена только добавляются: ссылки на строки в deque остаются действительными
+class SymbolTable {
+public:
+    uint32_t intern(std::string_view name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Поиск через переиспользуемый буфер: известное имя не выделяет память
+        key_.assign(name.data(), name.size());
+        auto it = ids_.find(key_);
+        if (it != ids_.end()) {
+            return it->second;
+        }
+        uint32_t id = static_cast<uint32_t>(names_.size());
+        ids_.emplace(key_, id);
+        names_.push_back(key_);
+        return id;
+    }
+
+    const std::string& name(uint32_t id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return names_[id];
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return names_.size();
+    }
+
+    // Таблица не разрушается при выходе: её переживают статические выражения
+    static SymbolTable& instance() {
+        static SymbolTable* table = new SymbolTable;
+        return *table;
+    }
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<std::string, uint32_t> ids_;
+    std::deque<std::string> names_;
+    std::string key_;
+};
+
+} // namespace
+
+Symbol::Symbol(std::string_view name)
+    : id_(SymbolTable::instance().intern(name)) {}
+
+const std::string& Symbol::name() const {
+    static const std::string empty;
+    return valid() ? SymbolTable::instance().name(id_) : empty;
+}
+
+size_t Symbol::count() {
+    return SymbolTable::instance().size();
+}
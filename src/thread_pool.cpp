@@ -0,0 +1,134 @@
+#include "../include/thread_pool.hpp"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) {
+        threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    ranges_ = std::make_unique<Range[]>(threads);
+    workers_.reserve(threads - 1);
+    for (size_t i = 1; i < threads; ++i) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body) {
+    grain = std::max<size_t>(1, grain);
+    if (workers_.empty() || count <= grain) {
+        if (count > 0) body(0, count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> call(callMutex_);
+
+    // Начальное разбиение: по равному непрерывному участку на поток,
+    // границы участков кратны grain
+    const size_t threads = size();
+    for (size_t i = 0; i < threads; ++i) {
+        std::lock_guard<std::mutex> lock(ranges_[i].mutex);
+        ranges_[i].next = count * i / threads / grain * grain;
+        ranges_[i].end = i + 1 == threads ? count : count * (i + 1) / threads / grain * grain;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        body_ = &body;
+        grain_ = grain;
+        active_ = workers_.size();
+        error_ = nullptr;
+        ++generation_;
+    }
+    wake_.notify_all();
+
+    runRanges(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return active_ == 0; });
+    body_ = nullptr;
+    if (error_) {
+        std::exception_ptr error = error_;
+        error_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+            if (stopping_) return;
+            seen = generation_;
+        }
+
+        runRanges(index);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--active_ == 0) {
+            done_.notify_one();
+        }
+    }
+}
+
+void ThreadPool::runRanges(size_t index) {
+    size_t begin = 0;
+    size_t end = 0;
+    while (takeOwn(index, begin, end) || (steal(index) && takeOwn(index, begin, end))) {
+        try {
+            (*body_)(begin, end);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) error_ = std::current_exception();
+        }
+    }
+}
+
+bool ThreadPool::takeOwn(size_t index, size_t& begin, size_t& end) {
+    Range& range = ranges_[index];
+    std::lock_guard<std::mutex> lock(range.mutex);
+    if (range.next >= range.end) return false;
+    begin = range.next;
+    end = std::min(range.end, range.next + grain_);
+    range.next = end;
+    return true;
+}
+
+// Забирает вторую половину чужого остатка в собственный участок. Середина
+// округляется вниз до кратной grain, чтобы границы блоков оставались кратными
+bool ThreadPool::steal(size_t index) {
+    const size_t threads = size();
+    for (size_t offset = 1; offset < threads; ++offset) {
+        Range& victim = ranges_[(index + offset) % threads];
+        size_t begin = 0;
+        size_t end = 0;
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.next >= victim.end) continue;
+            size_t remaining = victim.end - victim.next;
+            begin = victim.next;
+            if (remaining > grain_) {
+                begin = std::max(begin, (victim.next + remaining / 2) / grain_ * grain_);
+            }
+            end = victim.end;
+            victim.end = begin;
+        }
+        Range& own = ranges_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.next = begin;
+        own.end = end;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,69 @@
+#include "../include/tokenizer.hpp"
+#include "../include/stats.hpp"
+#include <charconv>
+
+namespace {
+
+bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f'; }
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+bool isAlpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+
+} // namespace
+
+void Tokenizer::advance() {
+    SYMDIFF_COUNT(TokensRead);
+    const char* data = input_.data();
+    const size_t size = input_.size();
+    while (pos_ < size && isSpace(data[pos_])) ++pos_;
+
+    current_ = Token{};
+    current_.offset = pos_;
+    if (pos_ == size) {
+        current_.kind = TokenKind::End;
+        return;
+    }
+
+    const size_t start = pos_;
+    const char c = data[pos_];
+    if (isAlpha(c)) {
+        while (pos_ < size && (isAlpha(data[pos_]) || isDigit(data[pos_]) || data[pos_] == '_')) ++pos_;
+        current_.kind = TokenKind::Identifier;
+    } else if (isDigit(c) || c == '.') {
+        auto [end, error] = std::from_chars(data + pos_, data + size, current_.number);
+        if (error == std::errc::invalid_argument) {
+            // Одинокая точка и подобное
+            ++pos_;
+            current_.kind = TokenKind::Invalid;
+        } else {
+            // Переполнение: лексема числа, но значение непредставимо
+            pos_ = static_cast<size_t>(end - data);
+            current_.kind = error == std::errc() ? TokenKind::Number : TokenKind::Invalid;
+        }
+    } else if (size_t length = matchSymbol()) {
+        pos_ += length;
+        current_.kind = TokenKind::Operator;
+    } else {
+        ++pos_;
+        switch (c) {
+            case '+': current_.kind = TokenKind::Plus; break;
+            case '-': current_.kind = TokenKind::Minus; break;
+            case '*': current_.kind = TokenKind::Star; break;
+            case '/': current_.kind = TokenKind::Slash; break;
+            case '^': current_.kind = TokenKind::Caret; break;
+            case '(': current_.kind = TokenKind::LParen; break;
+            case ')': current_.kind = TokenKind::RParen; break;
+            default:  current_.kind = TokenKind::Invalid; break;
+        }
+    }
+    current_.text = input_.substr(start, pos_ - start);
+}
+
+// Длина зарегистрированного знака в текущей позиции или 0
+size_t Tokenizer::matchSymbol() const {
+    if (!symbols_) return 0;
+    std::string_view rest = input_.substr(pos_);
+    for (const std::string& symbol : *symbols_) {
+        if (rest.substr(0, symbol.size()) == symbol) return symbol.size();
+    }
+    return 0;
+}
@@ -1,6 +1,28 @@
 #include "../include/Expression.hpp"
+#include "../include/compiler.hpp"
+#include "../include/batch.hpp"
+#include "../include/dual.hpp"
+#include "../include/jit.hpp"
+#include "../include/codegen.hpp"
+#include "../include/json.hpp"
+#include "../include/server.hpp"
+#include "../include/serialize.hpp"
+#include "../include/library.hpp"
+#include "../include/stats.hpp"
+#include "../include/parser.hpp"
+#include "../include/bulk_parser.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <cassert>
+#include <algorithm>
+#include <vector>
+#include <unistd.h>
 
 int test_count = 0;
 int passed_count = 0;
@@ -17,6 +39,10 @@ void check(const std::string& label, const std::string& actual, const std::strin
     }
 }
 
+void check(const std::string& label, bool actual, bool expected) {
+    check(label, std::string(actual ? "true" : "false"), std::string(expected ? "true" : "false"));
+}
+
 void check(const std::string& label, double actual, double expected, double eps = 1e-6) {
     ++test_count;
     if (std::abs(actual - expected) < eps) {
@@ -55,10 +81,441 @@ int main() {
     E expr2 = parseExpression<double>("x * y + 1");
     check("Evaluate x=10, y=2 for x*y+1", expr2.evaluate(vars), 21.0);
 
+    // Одинаковые подвыражения хранятся в одном экземпляре
+    check("Shared subterms compare equal",
+          parseExpression<double>("x * y + 1") == parseExpression<double>("(x*y) + 1"), true);
+    check("Different trees differ", parseExpression<double>("x - y") == parseExpression<double>("y - x"), false);
+
+    // Вычисление функций по дереву
+    E trig = parseExpression<double>("sin(x) ^ 2 + cos(x) ^ 2");
+    check("Evaluate sin(x)^2 + cos(x)^2", trig.evaluate({{"x", 0.7}}), 1.0);
+
     // Дифференцирование
     E expr3 = parseExpression<double>("x * sin(x)");
     E deriv = expr3.differentiate("x");
-    check("Differentiate x*sin(x)", deriv.toString(), "x * cos(x) + sin(x)");
+    check("Differentiate x*sin(x)", deriv.toString(), "(sin(x) + (x * cos(x)))");
+    check("Unsimplified derivative", expr3.differentiate("x", false).toString(), "((1 * sin(x)) + (x * (cos(x) * 1)))");
+
+    // Упрощение
+    check("Simplify identities", parseExpression<double>("0 * y + 1 * x + x * 1 - 0").simplify().toString(), "(2 * x)");
+    check("Simplify like terms and powers",
+          parseExpression<double>("x * y * x + y * x ^ 2 - 2 / 4").simplify().toString(), "((2 * ((x ^ 2) * y)) - 0.5)");
+    check("Simplify canonical order",
+          parseExpression<double>("y * x + sin(x)").simplify() == parseExpression<double>("sin(x) + x * y").simplify(), true);
+    check("Simplify canonical order of compound terms",
+          parseExpression<double>("exp(x * y) + sin(x + 1) * z + ln(z) ^ 2 - cos(y)").simplify()
+              == parseExpression<double>("ln(z) ^ 2 - cos(y) + z * sin(1 + x) + exp(y * x)").simplify(), true);
+
+
+    E cube = parseExpression<double>("x ^ 3 / y");
+    check("d/dx x^3/y at x=2, y=4", cube.differentiate("x").evaluate({{"x", 2}, {"y", 4}}), 3.0);
+    check("d/dy x^3/y at x=2, y=4", cube.differentiate("y").evaluate({{"x", 2}, {"y", 4}}), -0.5);
+
+    // Общий кэш производных: гессиан переиспользует производные подвыражений
+    E f = parseExpression<double>("sin(x * y) * exp(x) + x ^ 3 * y");
+    DerivativeCache<double> cache;
+    E fx = f.differentiate("x", cache);
+    E fy = f.differentiate("y", cache);
+    size_t missesBefore = cache.misses();
+    E fxy = fx.differentiate("y", cache);
+    E fyx = fy.differentiate("x", cache);
+    check("Cached derivative equals uncached", fxy == fx.differentiate("y"), true);
+    check("Derivative cache reused entries", cache.hits() > 0 && cache.misses() > missesBefore, true);
+    DerivativeCache<double> dag;
+    E common = E::sin(E("x") * E("y"));
+    (common * (common + E("x")) + E::exp(common) / common).differentiate("x", dag);
+    check("Derivative cache misses are created entries", dag.misses() == dag.size() && dag.hits() > 0, true);
+    check("Mixed partials agree", fxy.evaluate({{"x", 0.3}, {"y", 1.2}}), fyx.evaluate({{"x", 0.3}, {"y", 1.2}}));
+
+    // Компиляция в байткод
+    CompiledExpression<double> program = compile(parseExpression<double>("x * exp(y) + sin(x) ^ 2 - 3 / y"));
+    check("Compiled variables", program.variables().size() == 2 && program.slot("y") == 1, true);
+    double slots[] = {1.5, 0.25};
+    check("Compiled eval matches evaluate", program.eval(slots),
+          parseExpression<double>("x * exp(y) + sin(x) ^ 2 - 3 / y").evaluate({{"x", 1.5}, {"y", 0.25}}));
+    check("Compiled constant", compile(E(2.5)).eval(nullptr), 2.5);
+
+    // Общие подвыражения: y * x и x * y считаются одним значением
+    CompiledExpression<double> shared = compile(parseExpression<double>("sin(x * y) + cos(y * x) * sin(x * y)"));
+    check("CSE instruction count", static_cast<double>(shared.code().size()), 5.0);
+
+    // Совместная компиляция градиента
+    E h = parseExpression<double>("sin(x * y) * exp(x + y) / (1 + x ^ 2)");
+    std::vector<E> hGrad = {h.differentiate("x"), h.differentiate("y")};
+    CompiledExpression<double> joint = compile(hGrad, {"x", "y"});
+    size_t separate = compile(hGrad[0], {"x", "y"}).code().size() + compile(hGrad[1], {"x", "y"}).code().size();
+    double hSlots[] = {0.4, -1.1};
+    double hOut[2];
+    joint.evalAll(hSlots, hOut);
+    check("Joint compile shares code", joint.code().size() < separate, true);
+    check("Joint compile d/dx", hOut[0], hGrad[0].evaluate({{"x", 0.4}, {"y", -1.1}}));
+    check("Joint compile d/dy", hOut[1], hGrad[1].evaluate({{"x", 0.4}, {"y", -1.1}}));
+
+    // Градиент обратным проходом совпадает с символьными производными
+    E g = parseExpression<double>("x * y ^ 2 + sin(x * z) / z - ln(y) * x ^ z");
+    std::map<std::string, double> point = {{"x", 0.7}, {"y", 1.3}, {"z", 2.1}};
+    std::map<std::string, double> grad = g.gradient(point);
+    double gradError = 0;
+    for (const auto& [name, value] : grad) {
+        gradError = std::max(gradError, std::abs(value - g.differentiate(name).evaluate(point)));
+    }
+    check("Reverse-mode gradient matches differentiate", gradError, 0.0, 1e-12);
+
+    // Дуальные числа: производная по направлению без символьного дифференцирования
+    using D = Dual<double>;
+    Expression<D> gd = parseExpression<D>("x * y ^ 2 + sin(x * z) / z - ln(y) * x ^ z");
+    D directional = gd.evaluate({{"x", D(0.7, 1.0)}, {"y", D(1.3, -2.0)}, {"z", D(2.1, 0.5)}});
+    check("Dual value", directional.value, g.evaluate(point));
+    check("Dual directional derivative", directional.derivative, grad["x"] - 2.0 * grad["y"] + 0.5 * grad["z"]);
+
+    using H = HyperDual<double>;
+    CompiledExpression<H> hd = compile(parseExpression<H>("x ^ 3 * exp(-2 * x) / y"), {"x", "y"});
+    H hslots[] = {H(0.8, 1.0, 1.0), H(1.5)};
+    double second = parseExpression<double>("x ^ 3 * exp(-2 * x) / y").differentiate("x").differentiate("x")
+                        .evaluate({{"x", 0.8}, {"y", 1.5}});
+    check("Hyper-dual second derivative", hd.eval(hslots).d12, second);
+    H atZero[] = {H(0.0, 1.0, 1.0)};
+    H linear = compile(parseExpression<H>("x ^ 1"), {"x"}).eval(atZero);
+    H constant = compile(parseExpression<H>("x ^ 0"), {"x"}).eval(atZero);
+    check("Hyper-dual x^1 and x^0 at zero", linear.d1 == 1.0 && linear.d12 == 0.0 && constant.value == 1.0
+                                                && constant.d1 == 0.0 && constant.d12 == 0.0, true);
+
+    // Пакетное вычисление по столбцам, включая неполный последний блок
+    CompiledExpression<double> wave = compile(parseExpression<double>("sin(x) * exp(y) + ln(x) * cos(y)"));
+    std::vector<double> xs, ys, batch(19);
+    for (int i = 0; i < 19; ++i) {
+        xs.push_back(0.3 + i * 1.7);
+        ys.push_back(-2.0 + i * 0.25);
+    }
+    const double* columns[] = {xs.data(), ys.data()};
+    evaluateBatch(wave, columns, batch.data(), batch.size());
+    double maxError = 0;
+    for (int i = 0; i < 19; ++i) {
+        double point[] = {xs[i], ys[i]};
+        maxError = std::max(maxError, std::abs(batch[i] - wave.eval(point)));
+    }
+    check("Batch eval matches scalar eval", maxError, 0.0, 1e-12);
+
+    // Многопоточное пакетное вычисление даёт тот же результат в том же порядке
+    const size_t sweep = 100000;
+    std::vector<double> sx(sweep), sy(sweep), serial(sweep), parallel(sweep);
+    for (size_t i = 0; i < sweep; ++i) {
+        sx[i] = 0.5 + i * 1e-4;
+        sy[i] = std::sin(i * 1e-3);
+    }
+    const double* sweepColumns[] = {sx.data(), sy.data()};
+    ThreadPool pool(4);
+    evaluateBatch(wave, sweepColumns, serial.data(), sweep);
+    evaluateBatch(wave, sweepColumns, parallel.data(), sweep, pool);
+    check("Parallel batch matches serial batch", serial == parallel, true);
+
+    std::vector<int> visits(sweep, 0);
+    std::atomic<bool> aligned{true};
+    pool.parallelFor(sweep, 7, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) ++visits[i];
+        if (begin % 7 != 0 || (end - begin != 7 && end != sweep)) aligned = false;
+    });
+    check("parallelFor visits every index once",
+          std::all_of(visits.begin(), visits.end(), [](int v) { return v == 1; }), true);
+    check("parallelFor blocks aligned to grain", aligned.load(), true);
+
+    // Машинный код совпадает с интерпретатором (или сам им является без JIT)
+    CompiledExpression<double> mixed = compile(-(E("x") ^ E(2.5)) + E::ln(E("y")) * E::sin(E("x")) / E::cos(E("y"))
+                                         - E::exp(-E("y")) * E(3.0));
+    JitFunction native(mixed);
+    double jitError = 0;
+    for (int i = 0; i < 19; ++i) {
+        double point[] = {xs[i], 0.1 + i * 0.4};
+        jitError = std::max(jitError, std::abs(native(point) - mixed.eval(point)));
+    }
+    check("JIT matches interpreter", jitError, 0.0, 1e-12);
+
+    // Генерация C++: общие подвыражения вычисляются один раз, квадрат раскрыт
+    E cx("x");
+    check("Codegen source", generateCpp({cx * cx + E::sin(cx * cx)}),
+          "#include <cmath>\n#include <cstddef>\n\n"
+          "// _v0: x\n"
+          "inline void evaluate(double _v0, double* _out) {\n"
+          "    const double _t0 = _v0 * _v0;\n"
+          "    const double _t1 = std::sin(_t0);\n"
+          "    const double _t2 = _t0 + _t1;\n"
+          "    _out[0] = _t2;\n"
+          "}\n");
+
+    // Имена-ключевые слова и макросы <cmath> не попадают в код: исходник компилируется
+    // во временном каталоге; без компилятора проверка пропускается
+    if (std::system("c++ --version > /dev/null 2>&1") == 0) {
+        CodegenOptions kernel;
+        kernel.kernel = true;
+        E reserved = parseExpression<double>("int * for + NAN / HUGE_VAL");
+        std::string source = (std::filesystem::temp_directory_path() / "symdiff_codegen_XXXXXX.cpp").string();
+        int fd = mkstemps(source.data(), 4);
+        check("Codegen temporary source created", fd >= 0, true);
+        if (fd >= 0) {
+            close(fd);
+            std::ofstream(source) << generateCpp({reserved, reserved.differentiate("for")}, {}, kernel);
+            check("Codegen compiles with reserved names",
+                  std::system(("c++ -std=c++17 -fsyntax-only '" + source + "'").c_str()) == 0, true);
+            std::remove(source.c_str());
+        }
+    } else {
+        std::cout << "[SKIP] Codegen compiles with reserved names: no c++ compiler on PATH\n";
+    }
+    bool noOutputs = false;
+    try { generateCpp({}); } catch (const std::invalid_argument&) { noOutputs = true; }
+    check("Codegen rejects no outputs", noOutputs, true);
+
+    // Интернированные символы: одно имя — один номер, значения по номеру символа
+    Symbol symX("x"), symY("y");
+    check("Symbol interning", Symbol("x") == symX && symX != symY && E("x").symbol() == symX, true);
+    Bindings<double> bound;
+    bound.set(symX, 0.7);
+    bound.set(symY, 1.3);
+    E bindExpr = parseExpression<double>("x * sin(y) + y / x");
+    check("Evaluate with symbol bindings", bindExpr.evaluate(bound), bindExpr.evaluate({{"x", 0.7}, {"y", 1.3}}));
+    // Номера символов, разнесённые на тысячи других имён: отображение переходит
+    // в разреженный вид и не занимает память по числу всех символов
+    SymbolMap<int> farApart;
+    farApart.set(symX, 1);
+    for (int i = 0; i < 1000; ++i) Symbol("far_" + std::to_string(i));
+    Symbol symFar("far_symbol");
+    farApart.set(symFar, 2);
+    farApart.set(symX, 3);
+    check("Symbol map sparse ids", farApart.size() == 2 && *farApart.find(symX) == 3 && *farApart.find(symFar) == 2
+                                       && !farApart.find(symY), true);
+    check("Differentiate by symbol", bindExpr.differentiate(symY).toString(), bindExpr.differentiate("y").toString());
+
+    // Одновременная подстановка выражений: перестановка переменных за один проход
+    E swapped = parseExpression<double>("x - y * sin(z)").substitute({{"x", E("y")}, {"y", E("x")}});
+    check("Simultaneous substitution swaps variables", swapped.toString(), "(y - (x * sin(z)))");
+    E inner = parseExpression<double>("sin(z) * z");
+    E outer = inner + E("x");
+    E replaced = outer.substitute({{"x", E::exp(E("t"))}});
+    check("Substitution with expression", replaced.toString(), "((sin(z) * z) + exp(t))");
+    check("Substitution shares untouched subtrees", replaced.operand(0) == inner, true);
+
+    // Токенизатор: экспоненциальная запись чисел через from_chars, позиция ошибки
+    check("Parse scientific notation", parseExpression<double>("2.5e-3 * x1 + .5").evaluate({{"x1", 4.0}}), 0.51);
+    std::string parseError;
+    try {
+        parseExpression<double>("x + * 2");
+    } catch (const std::exception& ex) {
+        parseError = ex.what();
+    }
+    check("Parse error position", parseError, "Expected expression at line 1, column 5");
+
+    // JSON-записи пакетного режима
+    JsonValue record = parseJson(R"({"expression": "x * y", "variable": "x", "bindings": {"x": 2, "y": -1.5e1}})");
+    check("JSON record fields", record.find("expression")->string + "|" + record.find("variable")->string, "x * y|x");
+    check("JSON nested number", record.find("bindings")->find("y")->number, -15.0);
+    check("JSON quote escapes", jsonQuote("a\"b\\c\n"), R"("a\"b\\c\n")");
+    check("JSON nested within limit", parseJson(std::string(JsonMaxDepth, '[') + std::string(JsonMaxDepth, ']'))
+                                          .array.size() == 1, true);
+    std::string nestingError;
+    try {
+        parseJson("{\"expression\": " + std::string(1000000, '['));
+    } catch (const std::exception& ex) {
+        nestingError = ex.what();
+    }
+    check("JSON deep nesting rejected", nestingError, "JSON nesting exceeds the limit of 256 at position 270");
+    check("Batch record", processRecord(R"j({"expression":"x * y","variable":"x","bindings":{"x":2,"y":3}})j"),
+          R"j({"derivative":"y","value":3})j");
+    check("Batch record rejects string binding",
+          processRecord(R"j({"expression":"x + y","bindings":{"x":1,"y":"abc"}})j"),
+          R"j({"error":"Binding \"y\" is not a number"})j");
+
+    // Протокол сервера: выражение разбирается один раз и живёт под дескриптором
+    ExpressionServer server;
+    std::string parsed = server.handle(R"j({"op":"parse","expression":"x * y + sin(x)"})j");
+    check("Server parse", parsed, R"j({"handle":1,"expression":"((x * y) + sin(x))","variables":["x","y"]})j");
+    check("Server same expression reuses handle",
+          server.handle(R"j({"op":"parse","expression":"x*y+sin(x)"})j") == parsed, true);
+    check("Server diff", server.handle(R"j({"op":"diff","handle":1,"variable":"y"})j"),
+          R"j({"handle":2,"expression":"x","variables":["x"]})j");
+    check("Server eval", server.handle(R"j({"op":"eval","handle":2,"bindings":{"x":4}})j"), R"j({"value":4})j");
+    check("Server gradient", server.handle(R"j({"op":"gradient","handle":1,"bindings":{"x":0,"y":3}})j"),
+          R"j({"value":0,"gradient":{"x":4,"y":0}})j");
+    check("Server unknown handle", server.handle(R"j({"op":"eval","handle":9})j"), R"j({"error":"Unknown handle: 9"})j");
+    check("Server negative handle", server.handle(R"j({"op":"eval","handle":-1e300})j"),
+          R"j({"error":"Invalid handle"})j");
+    check("Server non-number handle", server.handle(R"j({"op":"release","handle":"1"})j"),
+          R"j({"error":"Invalid handle"})j");
+    server.handle(R"j({"op":"release","handle":2})j");
+    check("Server release", server.handles(), 1.0);
+
+    // Два клиента разобрали одно выражение: release одного не отнимает дескриптор у другого
+    ExpressionServer clients;
+    std::string firstClient = clients.handle(R"j({"op":"parse","expression":"x + 1"})j");
+    std::string secondClient = clients.handle(R"j({"op":"parse","expression":"x+1"})j");
+    check("Server shared handle", firstClient == secondClient, true);
+    check("Server release shared", clients.handle(R"j({"op":"release","handle":1})j"), R"j({"released":true})j");
+    check("Server shared handle survives", clients.handle(R"j({"op":"eval","handle":1,"bindings":{"x":2}})j"),
+          R"j({"value":3})j");
+    clients.handle(R"j({"op":"release","handle":1})j");
+    check("Server last release", clients.handles(), 0.0);
+    ParseLimits shallow;
+    shallow.maxDepth = 3;
+    check("Server max depth limits JSON",
+          ExpressionServer(shallow).handle(R"j({"op":"eval","expression":"x","bindings":{"x":[[1]]}})j"),
+          R"j({"error":"JSON nesting exceeds the limit of 3 at position 47"})j");
+    check("Server eval by expression keeps no handle",
+          clients.handle(R"j({"op":"eval","expression":"x * 2","bindings":{"x":2}})j") == R"j({"value":4})j"
+              && clients.handles() == 0, true);
+
+    // Двоичный формат: узлы хэш-консятся, поэтому загруженное выражение — тот же узел
+    {
+        Expression<double> f = parseExpression<double>("sin(x * y) * sin(x * y) + x ^ 2.5 / exp(y)");
+        Expression<double> df = f.differentiate("x");
+        std::string bytes = serializeExpressions<double>({f, df});
+        std::vector<Expression<double>> loaded = deserializeExpressions<double>(bytes);
+        check("Binary round trip", loaded.size() == 2 && loaded[0] == f && loaded[1] == df, true);
+        check("Binary shares subterms", SerializedGraph<double>(bytes).nodeCount() < 40, true);
+
+        std::string corrupt = bytes;
+        corrupt[corrupt.size() - 4] = 100;  // корень за пределами таблицы узлов
+        bool rejected = false;
+        try { deserializeExpressions<double>(corrupt); } catch (const std::runtime_error&) { rejected = true; }
+        check("Binary rejects corrupt root", rejected, true);
+        rejected = false;
+        try { deserializeExpressions<std::complex<double>>(bytes); } catch (const std::runtime_error&) { rejected = true; }
+        check("Binary rejects other value type", rejected, true);
+
+        Expression<std::complex<double>> z = Expression<std::complex<double>>(std::complex<double>(1.5, -2.0)) * Expression<std::complex<double>>("z");
+        saveExpressions<std::complex<double>>("test_graph.sdx", {z});
+        check("Binary file round trip", loadExpressions<std::complex<double>>("test_graph.sdx")[0] == z, true);
+        std::remove("test_graph.sdx");
+    }
+
+    // Библиотека: поиск по имени, выражения строятся только по запросу
+    {
+        Expression<double> x("x"), y("y");
+        saveLibrary<double>("test_library.sdxl", {{"square", x * x}, {"area", x * y}, {"bump", Expression<double>::exp(x * x)}});
+        ExpressionLibrary<double> library("test_library.sdxl");
+        check("Library entries sorted by name", std::string(library.name(0)) + "," + std::string(library.name(2)), "area,square");
+        check("Library lookup", library.get("bump") == Expression<double>::exp(x * x), true);
+        check("Library builds lazily", library.materialized(), 1.0);
+        check("Library compiled entry", library.compiled("area").eval({{"x", 3.0}, {"y", 4.0}}), 12.0);
+        check("Library missing name", library.find("volume") == ExpressionLibrary<double>::npos, true);
+
+        // graphOffset + graphSize переполняется и даёт размер файла
+        std::string image;
+        {
+            std::ifstream in("test_library.sdxl", std::ios::binary);
+            image.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        uint64_t wrappedOffset = uint64_t(1) << 63;
+        uint64_t wrappedSize = image.size() - wrappedOffset;
+        std::memcpy(&image[offsetof(LibraryHeader, graphOffset)], &wrappedOffset, sizeof(wrappedOffset));
+        std::memcpy(&image[offsetof(LibraryHeader, graphSize)], &wrappedSize, sizeof(wrappedSize));
+        std::ofstream("test_library.sdxl", std::ios::binary) << image;
+        bool wrappedRejected = false;
+        try { ExpressionLibrary<double> corrupt("test_library.sdxl"); } catch (const std::runtime_error&) { wrappedRejected = true; }
+        check("Library rejects wrapped graph size", wrappedRejected, true);
+        std::remove("test_library.sdxl");
+    }
+
+    // Таблица операций: унарный минус, правая ассоциативность ^, свои операции
+    check("Unary minus", parseExpression<double>("-x * y - -(x + 1)").toString(), "((-x * y) - -(x + 1))");
+    check("Unary minus binds looser than power", parseExpression<double>("-2 ^ 2").evaluate({{"x", 0.0}}), -4.0);
+    check("Negative literal", parseExpression<double>("x ^ -2").toString(), "(x ^ -2)");
+    check("Power is right associative", parseExpression<double>("2 ^ 3 ^ 2").evaluate({{"x", 0.0}}), 512.0);
+    {
+        E base = -E("x") ^ E(2.0);
+        check("Signed power base round trip", parseExpression<double>(base.toString()) == base, true);
+
+        OperatorTable<double> ops = OperatorTable<double>::standard();
+        ops.addInfix("**", 40, OperatorTable<double>::Associativity::Right, [](const E& a, const E& b) { return a ^ b; });
+        ops.addInfix("over", 20, OperatorTable<double>::Associativity::Left, [](const E& a, const E& b) { return a / b; });
+        ops.addPrefix("+", 30, [](const E& a) { return a; });
+        ops.addFunction("sqr", [](const E& a) { return a * a; });
+        check("User infix operator", parseExpression<double>("2 ** 3 ** 2", ops).evaluate({{"x", 0.0}}), 512.0);
+        check("User word operator", parseExpression<double>("x over 2 * 3", ops).toString(), "((x / 2) * 3)");
+        check("User prefix and function", parseExpression<double>("+sqr(x + 1)", ops).toString(), "((x + 1) * (x + 1))");
+        ops.addFunction("twice", [](const E& a) { return parseExpression<double>("2 * u").substitute({{"u", a}}); });
+        check("Nested parse in user function", parseExpression<double>("twice(x + y) - 1", ops).toString(), "((2 * (x + y)) - 1)");
+
+        bool rejected = false;
+        try { ops.addInfix("(", 1, OperatorTable<double>::Associativity::Left, [](const E& a, const E&) { return a; }); }
+        catch (const std::invalid_argument&) { rejected = true; }
+        check("Operator symbol validated", rejected, true);
+
+        size_t line = 0, column = 0;
+        try { parseExpression<double>("x +\n  y $ 2"); }
+        catch (const ParseError& e) { line = e.line(); column = e.column(); }
+        check("Parse error line and column", std::to_string(line) + ":" + std::to_string(column), "2:5");
+    }
+
+    // Глубокие выражения: обходы идут по явным стекам, а не по стеку потока
+    {
+        E x("x");
+        E chain = x;
+        for (int i = 0; i < 200000; ++i) chain = chain + x * E(2.0);
+        std::string text = chain.toString();
+        E parsed = parseExpression<double>(text);
+        check("Deep chain parse round trip", parsed == chain, true);
+        check("Deep chain evaluate", chain.evaluate({{"x", 1.5}}), 1.5 * 400001);
+        check("Deep chain derivative", chain.differentiate("x", false).evaluate({{"x", 1.5}}), 400001.0);
+        check("Deep chain compiled", compile(chain, {"x"}).eval({{"x", 1.5}}), 1.5 * 400001);
+        check("Deep chain substitute", chain.substitute({{"x", E(1.0)}}).evaluate(std::map<std::string, double>()), 400001.0);
+
+        E nested = x;
+        for (int i = 0; i < 20000; ++i) nested = E::sin(nested);
+        check("Deep nesting simplify", nested.simplify() == nested, true);
+    }
+    check("Deep parentheses", parseExpression<double>(std::string(100000, '(') + "x" + std::string(100000, ')')).toString(), "x");
+
+    // Ограничения разбора для недоверенного ввода
+    {
+        ParseLimits limits;
+        limits.maxDepth = 3;
+        std::string error;
+        try { parseExpression<double>("((((x))))", limits); } catch (const std::exception& e) { error = e.what(); }
+        check("Parse depth limit", error, "Expression nesting exceeds the limit of 3 at line 1, column 4");
+        check("Parse depth within limit", parseExpression<double>("sin((x))", limits).toString(), "sin(x)");
+
+        limits = ParseLimits();
+        limits.maxNodes = 5;
+        error.clear();
+        try { parseExpression<double>("x + y * z + 1", limits); } catch (const std::exception& e) { error = e.what(); }
+        check("Parse node limit", error, "Expression exceeds the limit of 5 nodes at line 1, column 11");
+
+        limits = ParseLimits();
+        limits.maxDepth = 2;
+        ExpressionServer limited(limits);
+        check("Server depth limit", limited.handle(R"j({"op":"parse","expression":"sin(sin(sin(x)))"})j"),
+              R"j({"error":"Expression nesting exceeds the limit of 2 at line 1, column 9","offset":8,"line":1,"column":9})j");
+    }
+
+    // Пакетный разбор: участки по границам строк на всех потоках пула
+    {
+        std::string catalog;
+        for (int i = 0; i < 20000; ++i) {
+            catalog += "x" + std::to_string(i % 7) + " * sin(y + " + std::to_string(i % 100) + ") - -z\n";
+            if (i % 1000 == 0) catalog += "   \n";
+        }
+        ThreadPool pool(4);
+        std::vector<E> bulk = parseLines<double>(catalog, pool);
+        bool same = bulk.size() == 20000;
+        for (int i = 0; same && i < 20000; i += 997) {
+            same = bulk[i] == parseExpression<double>("x" + std::to_string(i % 7) + " * sin(y + " + std::to_string(i % 100) + ") - -z");
+        }
+        check("Bulk parse matches line by line", same, true);
+        check("Bulk parse shares nodes across lines", bulk[0] == bulk[700], true);
+
+        size_t line = 0;
+        try { parseLines<double>(catalog + "x +\n" + catalog, pool); }
+        catch (const ParseError& e) { line = e.line(); }
+        check("Bulk parse error line", static_cast<double>(line), 20000 + 20 + 1);
+    }
+
+    // Статистика: без -DSYMDIFF_STATS счётчики остаются нулевыми
+    Stats::reset();
+    parseExpression<double>("x + 1");
+    Stats::Snapshot stats = Stats::snapshot();
+    check("Stats tokens read", static_cast<double>(stats.counters[static_cast<size_t>(Counter::TokensRead)]),
+          Stats::enabled() ? 4.0 : 0.0);
+    check("Stats parse timer", static_cast<double>(stats.calls[static_cast<size_t>(Timer::Parse)]),
+          Stats::enabled() ? 1.0 : 0.0);
 
     std::cout << "\nPassed " << passed_count << " of " << test_count << " tests.\n";
     return 0;